@@ -0,0 +1,319 @@
+/*
+ * Copyright (C) 2025 Ték Róbert Máté <eppenpontaz@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ChunkedRender.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+using namespace std;
+using namespace TRM;
+
+// Runs the tools non-interactively, many jobs at a time.
+//
+//   batch_runner [--jobs N] [--bin DIR] [--logs DIR] manifest.txt
+//
+// Every line of the manifest is a job: the tool, then the answers to its prompts in the order
+// it asks them (see AnswerPromptsFrom() in Utils/Prompt.hpp). Answers with spaces go in double
+// quotes, empty lines and lines starting with # are skipped:
+//
+//   # tool    answers...
+//   wavdiff   takes/di_01.wav  0  "derivatives/di 01.wav"
+//   node_y    takes/di_48.wav  10  5  out/euler.wav  out/iir.wav
+//
+// The tools are looked up in DIR (default: on the PATH), relative paths are relative to the
+// current directory. N jobs run at once (default: one per core), the console output of each
+// goes to <logs DIR>/<line>_<tool>.log (default: <manifest>_logs next to the manifest).
+// Every job is reported with its wall clock time, CPU time and peak memory use.
+
+struct BatchSettings
+{
+    size_t jobs = max(1u, thread::hardware_concurrency());
+    optional<filesystem::path> binDir;
+    optional<filesystem::path> logDir;
+    filesystem::path manifest;
+};
+
+struct Job
+{
+    size_t line = 0;
+    vector<string> args; // The tool and its answers
+};
+
+struct JobResult
+{
+    optional<string> error;
+    double seconds    = 0.0;
+    double cpuSeconds = 0.0;
+    double peakMB     = 0.0;
+};
+
+void PrintUsage ()
+{
+    cout << "Usage: batch_runner [--jobs N] [--bin DIR] [--logs DIR] manifest.txt\n"
+            "  --jobs   number of jobs run at once (default: number of cores)\n"
+            "  --bin    directory of the tools (default: search the PATH)\n"
+            "  --logs   directory of the job logs (default: <manifest>_logs)\n"
+            "Manifest lines:  tool answer...  (answers with spaces in double quotes, # comments)\n";
+}
+
+optional<BatchSettings> ParseArguments (const int argc, const char* const* argv)
+{
+    BatchSettings settings;
+    bool hasManifest = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const string_view arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+
+        bool ok = true;
+        if (arg == "--jobs" && hasValue)
+        {
+            const string_view value = argv[++i];
+            const auto [ptr, ec] = from_chars(value.data(), value.data() + value.size(), settings.jobs);
+            ok = ec == errc{} && ptr == value.data() + value.size() && settings.jobs > 0;
+        }
+        else if (arg == "--bin"  && hasValue) settings.binDir = argv[++i];
+        else if (arg == "--logs" && hasValue) settings.logDir = argv[++i];
+        else if (arg.starts_with("--") || hasManifest) ok = false;
+        else
+        {
+            settings.manifest = arg;
+            hasManifest = true;
+        }
+
+        if (!ok)
+        {
+            cout << format(" ! Invalid argument: {} !\n", arg);
+            return nullopt;
+        }
+    }
+
+    if (!hasManifest)
+        return nullopt;
+
+    return settings;
+}
+
+// Splits a manifest line at whitespace, "..." is kept together. nullopt for an unterminated quote.
+optional<vector<string>> SplitLine (const string_view line)
+{
+    vector<string> words;
+    for (size_t i = 0; i < line.size();)
+    {
+        if (isspace(static_cast<unsigned char>(line[i])))
+        {
+            ++i;
+            continue;
+        }
+
+        string word;
+        if (line[i] == '"')
+        {
+            const size_t end = line.find('"', i + 1);
+            if (end == string_view::npos)
+                return nullopt;
+            word = line.substr(i + 1, end - i - 1);
+            i = end + 1;
+        }
+        else
+        {
+            const size_t begin = i;
+            while (i < line.size() && !isspace(static_cast<unsigned char>(line[i])))
+                ++i;
+            word = line.substr(begin, i - begin);
+        }
+        words.push_back(move(word));
+    }
+    return words;
+}
+
+optional<vector<Job>> ReadManifest (const filesystem::path& path)
+{
+    ifstream file{path};
+    if (!file)
+    {
+        cout << format(" ! Cannot open {} !\n", path.string());
+        return nullopt;
+    }
+
+    vector<Job> jobs;
+    string line;
+    for (size_t lineNumber = 1; getline(file, line); ++lineNumber)
+    {
+        const size_t first = line.find_first_not_of(" \t\r");
+        if (first == string::npos || line[first] == '#')
+            continue;
+
+        auto words = SplitLine(line);
+        if (!words)
+        {
+            cout << format(" ! {}:{}: missing closing quote !\n", path.string(), lineNumber);
+            return nullopt;
+        }
+        jobs.push_back(Job{ .line = lineNumber, .args = move(*words) });
+    }
+    return jobs;
+}
+
+// Runs the tool with its console output going to 'log', waits for it and measures it
+JobResult RunJob (const BatchSettings& settings, const Job& job, const filesystem::path& log)
+{
+    JobResult result;
+
+    const string tool = settings.binDir && job.args[0].find('/') == string::npos
+                      ? (*settings.binDir / job.args[0]).string()
+                      : job.args[0];
+
+    vector<char*> argv;
+    argv.push_back(const_cast<char*>(tool.c_str()));
+    for (size_t i = 1; i < job.args.size(); ++i)
+        argv.push_back(const_cast<char*>(job.args[i].c_str()));
+    argv.push_back(nullptr);
+
+    // No console input: a tool that runs out of answers stops instead of waiting for one
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, log.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+
+    const auto start = chrono::steady_clock::now();
+    pid_t pid = 0;
+    const int spawnError = posix_spawnp(&pid, tool.c_str(), &actions, nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (spawnError != 0)
+    {
+        result.error = format("cannot start {}", tool);
+        return result;
+    }
+
+    int status = 0;
+    rusage usage{};
+    while (wait4(pid, &status, 0, &usage) < 0)
+    {
+        if (errno != EINTR)
+        {
+            result.error = "lost track of the process";
+            return result;
+        }
+    }
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    auto Seconds = [](const timeval& t){ return static_cast<double>(t.tv_sec) + static_cast<double>(t.tv_usec) * 1e-6; };
+    result.cpuSeconds = Seconds(usage.ru_utime) + Seconds(usage.ru_stime);
+#if defined(__APPLE__)
+    result.peakMB = static_cast<double>(usage.ru_maxrss) / (1024. * 1024.); // Bytes
+#else
+    result.peakMB = static_cast<double>(usage.ru_maxrss) / 1024.;           // Kilobytes
+#endif
+
+    if (WIFSIGNALED(status))
+        result.error = format("killed by signal {}", WTERMSIG(status));
+    else if (WIFEXITED(status) && WEXITSTATUS(status) != 0)
+        result.error = format("exit code {}", WEXITSTATUS(status));
+
+    return result;
+}
+
+int main (const int argc, const char* const* argv)
+{
+    const auto settings = ParseArguments(argc, argv);
+    if (!settings)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    const auto jobs = ReadManifest(settings->manifest);
+    if (!jobs)
+        return 1;
+
+    const filesystem::path logDir = settings->logDir.value_or(
+        filesystem::path{settings->manifest}.replace_filename(settings->manifest.stem().string() + "_logs"));
+    error_code ec;
+    filesystem::create_directories(logDir, ec);
+    if (ec)
+    {
+        cout << format(" ! Cannot create {}: {} !\n", logDir.string(), ec.message());
+        return 1;
+    }
+
+    size_t finished = 0;
+    size_t failures = 0;
+    double jobSeconds = 0.0;
+    mutex coutMutex;
+
+    const auto start = chrono::steady_clock::now();
+
+    ParallelFor(jobs->size(), settings->jobs, [&](const size_t i)
+    {
+        const Job& job = (*jobs)[i];
+        const filesystem::path toolName = filesystem::path{job.args[0]}.filename();
+        const filesystem::path log = logDir / format("{}_{}.log", job.line, toolName.string());
+
+        const JobResult result = RunJob(*settings, job, log);
+
+        string command;
+        for (const string& arg : job.args)
+            command += (command.empty() ? "" : " ") + arg;
+
+        const lock_guard lock{coutMutex};
+        ++finished;
+        jobSeconds += result.seconds;
+        const string progress = format("[{}/{}]", finished, jobs->size());
+        if (result.error)
+        {
+            ++failures;
+            cout << format("{} ! line {}: {}: {}, see {} !\n", progress, job.line, command, *result.error, log.string());
+        }
+        else
+        {
+            cout << format("{} {}: {:.2f} s, {:.2f} s CPU, {:.1f} MB peak\n",
+                           progress, command, result.seconds, result.cpuSeconds, result.peakMB);
+        }
+    });
+
+    const chrono::duration<double> total = chrono::steady_clock::now() - start;
+    cout << format("Finished {} of {} job(s) in {:.2f} s ({:.2f} s of job time, {:.1f}x on {} worker(s))\n",
+                   jobs->size() - failures, jobs->size(), total.count(),
+                   jobSeconds, total.count() > 0.0 ? jobSeconds / total.count() : 0.0, min(settings->jobs, jobs->size()));
+
+    return failures == 0 ? 0 : 2;
+}
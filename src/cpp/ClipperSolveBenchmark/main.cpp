@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2025 Ték Róbert Máté <eppenpontaz@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "DiodeClipperSolver.hpp"
+#include "DiodeClipperTable.hpp"
+#include "PerfCounters.hpp"
+#include "Stopwatch.hpp"
+#include "TS808Components.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace std;
+using namespace TRM;
+
+// CalcClipping of the original processImpl: std::upper_bound with the key computed in the predicate
+double CalcClipping_UpperBound (const double A, const double _C)
+{
+    const double C = abs(_C);
+    auto Pred = [&](const double, const Measurement& m){ return C < fma(m.x, A, m.y); };
+
+    const auto Upper = upper_bound(begin(Diode_1N4148_AntiPar_IVTable_SparsePoint5),
+                                   end(Diode_1N4148_AntiPar_IVTable_SparsePoint5),
+                                   0.0, // dummy value
+                                   Pred);
+    const auto Lower = Upper-1;
+
+    if (Upper == end(Diode_1N4148_AntiPar_IVTable_SparsePoint5)) [[unlikely]]
+    {
+        return 0.0;
+    }
+    if (Upper == begin(Diode_1N4148_AntiPar_IVTable_SparsePoint5)) [[unlikely]]
+    {
+        return 0.0;
+    }
+
+    const Measurement& upper = *Upper;
+    const Measurement& lower = *Lower;
+
+    const double distLower = C - fma(lower.x, A, lower.y);
+    const double distUpper = fma(upper.x, A, upper.y) - C;
+
+    const double range = fma(upper.x, A, upper.y) - fma(lower.x, A, lower.y);
+
+    return copysign((distLower < distUpper ? (lerp(upper.x, lower.x, distUpper/range)) :
+                                             (lerp(lower.x, upper.x, distLower/range))),
+                    _C);
+}
+
+// Where the hardware counters are available (Linux), every solve also reports cycles, IPC,
+// cache and branch misses per solved sample: the upper_bound search mispredicts, the others must not.
+int main ()
+{
+    constexpr double h = 1. / 192'000.;
+    constexpr size_t Count = 20'000'000;
+
+    for (const double gain : {0.0, 0.3, 0.7, 1.0})
+    {
+        const double A = (Cf/h) + (1./(Rf + gain * Rd));
+
+        DiodeClipperSolver solver;
+        solver.SetA(A);
+
+        DiodeClipperTableCache tables;
+        tables.Setup(h);
+        tables.SetA(A);
+
+        // Inputs spread over the whole table, plus some beyond its end
+        const double maxKey = fma(Diode_1N4148_AntiPar_IVTable_SparsePoint5.back().x, A, Diode_1N4148_AntiPar_IVTable_SparsePoint5.back().y);
+        mt19937_64 rng{42};
+        uniform_real_distribution<double> dist{-1.05 * maxKey, 1.05 * maxKey};
+        vector<double> in(Count);
+        for (double& c : in) c = dist(rng);
+
+        vector<double> reference(Count), solved(Count), solvedLanes(Count), tabulated(Count);
+
+        cout << format("gain = {}\n", gain);
+        {
+            const string label = " upper_bound + predicate fma:";
+            ScopedPerfCounters counters{"   ", static_cast<double>(Count), "solve"}; // printed after the time
+            Stopwatch sw{label};
+            for (size_t i = 0; i < Count; ++i)
+                reference[i] = CalcClipping_UpperBound(A, in[i]);
+        }
+        {
+            const string label = " DiodeClipperSolver (scalar):";
+            ScopedPerfCounters counters{"   ", static_cast<double>(Count), "solve"}; // printed after the time
+            Stopwatch sw{label};
+            for (size_t i = 0; i < Count; ++i)
+                solved[i] = solver(in[i]);
+        }
+        {
+            const string label = " DiodeClipperSolver (4 lanes):";
+            ScopedPerfCounters counters{"   ", static_cast<double>(Count), "solve"}; // printed after the time
+            Stopwatch sw{label};
+            for (size_t i = 0; i + 4 <= Count; i += 4)
+            {
+                Lanes<4> c;
+                copy_n(in.begin() + i, 4, c.v.begin());
+                const Lanes<4> x = solver(c);
+                copy_n(x.v.begin(), 4, solvedLanes.begin() + i);
+            }
+        }
+
+        {
+            const string label = " DiodeClipperTableCache:";
+            ScopedPerfCounters counters{"   ", static_cast<double>(Count), "solve"}; // printed after the time
+            Stopwatch sw{label};
+            for (size_t i = 0; i < Count; ++i)
+                tabulated[i] = tables(in[i]);
+        }
+
+        double maxDiff = 0.0, maxDiffLanes = 0.0, maxDiffTable = 0.0;
+        for (size_t i = 0; i < Count; ++i)
+        {
+            maxDiff      = max(maxDiff,      abs(reference[i] - solved[i]));
+            maxDiffLanes = max(maxDiffLanes, abs(reference[i] - solvedLanes[i]));
+            if (abs(in[i]) < maxKey) // the table saturates beyond the I-V table, the others return 0
+                maxDiffTable = max(maxDiffTable, abs(reference[i] - tabulated[i]));
+        }
+        cout << format(" └ max |upper_bound - scalar| = {:.3e}, max |upper_bound - lanes| = {:.3e}, max |upper_bound - table| = {:.3e}\n",
+                       maxDiff, maxDiffLanes, maxDiffTable);
+    }
+}
@@ -21,78 +21,162 @@
 #include "Prompt.hpp"
 #include "Stopwatch.hpp"
 #include "Utility.hpp"
+#include "WavStream.hpp"
 
 #include <algorithm>
 #include <cmath>
+#include <complex>
 #include <format>
 #include <numeric>
-#include <ranges>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
 
 using namespace std;
 using namespace TRM;
 
+// One decimator of the comparison, fed with the streamed input block by block
+template<class Decimator, std::size_t ChunkSz>
+struct DecimatorRun
+{
+    std::string scenario;
+    Decimator method{};
+    CumulativeStopwatch stopwatch{};
+    std::vector<double> out48{};
+
+    // 'in192' is a whole number of chunks
+    const std::vector<double>& Process(std::span<const double> in192)
+    {
+        out48.resize(in192.size() / 4);
+        stopwatch.Measure([&]
+        {
+            auto src = in192.begin();
+            auto dst = out48.begin();
+            for (auto i = in192.size() / ChunkSz; i-->0;)
+            {
+                src = method.Load(src);
+                dst = method.Apply(dst);
+            }
+        });
+        return out48;
+    }
 
-int main ()
+    void PrintTime() const { stopwatch.Print(scenario); }
+};
+
+
+int main (const int argc, const char* const* argv)
 {
-    const auto inputFile192 = Prompt<ExistingAudioFile> ("Enter input file path (192 kHz, > 10 samples)",
-                                                         AllOf | SampleRate(192'000) | NonEmpty);
-    inputFile192.printSummary();
+    AnswerPromptsFrom(argc, argv);
+
+    const auto inputFile192 = Prompt<ExistingWavFile> ("Enter input file path (192 kHz, > 10 samples)",
+                                                       AllOf | SampleRate(192'000) | NonEmpty);
+    inputFile192.PrintSummary();
 
     constexpr std::size_t LeftCh = 0u;
 
-    const auto& in192 = inputFile192.samples[LeftCh];
+    // Magnitude response at 'f' Hz of a filter running at 'sampleRate'
+    auto Gain = [](const auto& coeffs, const double f, const double sampleRate)
+    {
+        complex<double> sum = 0.0;
+        for (size_t k = 0; k < coeffs.size(); ++k)
+            sum += coeffs[k] * polar(1.0, -2.0 * numbers::pi * f * static_cast<double>(k) / sampleRate);
+        return abs(sum);
+    };
+    // The half-band cascade is the 1st stage times the 2nd stage at half the sample rate
+    auto GainD4x      = [&](const double f) { return Gain(Decimation::D4x_Coeffs, f, 192'000.); };
+    auto GainHalfBand = [&](const double f) { return Gain(Decimation::HB1_Coeffs, f, 192'000.) * Gain(Decimation::HB2_Coeffs, f, 96'000.); };
+
+    // Passband up to 20 kHz, everything from 28 kHz aliases into it (or into 20 - 24 kHz) at 48 kHz
+    auto PrintResponse = [](const string& name, auto gain)
+    {
+        double passMin = 1.0, passMax = 1.0, stopMax = 0.0;
+        for (double f = 0.0; f <= 20'000.; f += 50.)
+        {
+            passMin = min(passMin, gain(f));
+            passMax = max(passMax, gain(f));
+        }
+        for (double f = 28'000.; f <= 96'000.; f += 50.)
+            stopMax = max(stopMax, gain(f));
+        cout << format("{}: passband {:+.3f} .. {:+.3f} dB, stopband (>= 28 kHz) {:.1f} dB\n",
+                       name, 20. * log10(passMin), 20. * log10(passMax), 20. * log10(stopMax));
+    };
+    PrintResponse("D4x / D4x_Poly (105 multiply-adds per output)", GainD4x);
+    PrintResponse("D4x_HalfBand   (47 multiply-adds per output)", GainHalfBand);
 
     auto CompareRegularVsPolyphase = [&]<std::size_t ChunkSz>(std::integral_constant<std::size_t, ChunkSz>, const bool exportResult) -> void
     {
         static_assert(ChunkSz >= Decimation::D4x_Coeffs.size());
         static_assert(ChunkSz % 4 == 0);
+        static_assert(DefaultWavBlockFrames % ChunkSz == 0); // Only the last block can end with a partial chunk
 
-        const auto Iterations = in192.size() / ChunkSz;
-        const auto OutSz      = Iterations * ChunkSz / 4;
+        optional<WavWriter> exportFile;
+        if (exportResult)
+            exportFile.emplace(Prompt<string>(" └ Enter output file name: "), WavFormat{ .sampleRate = 48'000, .channels = 1, .bitDepth = 24 });
 
-        vector<double> out48;
-        out48.resize(OutSz);
+        using enum FIRKernel;
+        DecimatorRun<Decimation::D4x<ChunkSz, false, Scalar>,              ChunkSz> naiveScalar   {format("Naive approach, scalar (chunk size = {}):",     ChunkSz)};
+        DecimatorRun<Decimation::D4x<ChunkSz, false, Vectorized>,          ChunkSz> naive         {format("Naive approach, SIMD (chunk size = {}):",       ChunkSz)};
+        DecimatorRun<Decimation::D4x<ChunkSz, false, Folded>,              ChunkSz> naiveFolded   {format("Naive approach, folded (chunk size = {}):",     ChunkSz)};
+        DecimatorRun<Decimation::D4x_Poly<ChunkSz, false, Scalar>,         ChunkSz> polyScalar    {format("Polyphase approach, scalar (chunk size = {}):", ChunkSz)};
+        DecimatorRun<Decimation::D4x_Poly<ChunkSz, false, Vectorized>,     ChunkSz> polySimd      {format("Polyphase approach, SIMD (chunk size = {}):",   ChunkSz)};
+        DecimatorRun<Decimation::D4x_Poly<ChunkSz, false, Folded>,         ChunkSz> poly          {format("Polyphase approach, folded (chunk size = {}):", ChunkSz)};
+        DecimatorRun<Decimation::D4x_HalfBand<ChunkSz, false, Scalar>,     ChunkSz> halfBandScalar{format("Half-band cascade, scalar (chunk size = {}):",  ChunkSz)};
+        DecimatorRun<Decimation::D4x_HalfBand<ChunkSz, false, Vectorized>, ChunkSz> halfBandSimd  {format("Half-band cascade, SIMD (chunk size = {}):",    ChunkSz)};
+        DecimatorRun<Decimation::D4x_HalfBand<ChunkSz, false, Folded>,     ChunkSz> halfBand      {format("Half-band cascade, folded (chunk size = {}):",  ChunkSz)};
 
-        auto Flush = [&]
+        // The SIMD kernels sum in a different order than std::inner_product
+        auto MaxDifference = [](double& result, const vector<double>& a, const vector<double>& b)
         {
-            if (exportResult)
-            {
-                AudioFile<double> outputFile;
-                outputFile.setSampleRate(48'000);
-                outputFile.setBitDepth(24);
-                outputFile.setAudioBuffer({move(out48)});
-                auto outputFileName = Prompt<string>(" └ Enter output file name: ");
-                if (!outputFile.save(outputFileName))
-                {
-                    cout << " ! Failed to write output file !\n";
-                }
-            }
-            else
-            {
-                out48.clear();
-            }
-            out48.resize(OutSz);
+            for (size_t i = 0; i < min(a.size(), b.size()); ++i)
+                result = max(result, abs(a[i] - b[i]));
         };
+        double naiveSimdError = 0.0, polySimdError = 0.0, naiveFoldedError = 0.0, polyFoldedError = 0.0;
+        double halfBandSimdError = 0.0, halfBandFoldedError = 0.0;
 
-        auto RunBench = [&](auto method, std::string scenario)
+        // The file is streamed once, every decimator processes each block in turn
+        WavReader reader{inputFile192.path};
+        vector<double> in192;
+        for (auto block = reader.NextBlock(); !block.empty(); block = reader.NextBlock())
         {
-            auto src = in192.begin();
-            auto dst = out48.begin();
-            {
-                Stopwatch sw{scenario};
+            in192.clear();
+            for (size_t i = LeftCh; i < block.size(); i += inputFile192.Format().channels)
+                in192.push_back(block[i]);
+            in192.resize(in192.size() / ChunkSz * ChunkSz);
 
-                for (auto i = Iterations; i-->0;)
-                {
-                    src = method.Load(src);
-                    dst = method.Apply(dst);
-                }
-            }
-            Flush();
-        };
+            MaxDifference(naiveSimdError,   naiveScalar.Process(in192), naive.Process(in192));
+            MaxDifference(naiveFoldedError, naiveScalar.out48,          naiveFolded.Process(in192));
+            MaxDifference(polySimdError,    polyScalar.Process(in192),  polySimd.Process(in192));
+            MaxDifference(polyFoldedError,  polyScalar.out48,           poly.Process(in192));
+
+            MaxDifference(halfBandSimdError,   halfBandScalar.Process(in192), halfBandSimd.Process(in192));
+            MaxDifference(halfBandFoldedError, halfBandScalar.out48,          halfBand.Process(in192));
+
+            if (exportFile)
+                exportFile->Write(poly.out48);
+        }
 
-        RunBench(Decimation::D4x<ChunkSz, false>{},      format("Naive approach (chunk size = {}):",     ChunkSz));
-        RunBench(Decimation::D4x_Poly<ChunkSz, false>{}, format("Polyphase approach (chunk size = {}):", ChunkSz));
+        naiveScalar.PrintTime();
+        naive.PrintTime();
+        naiveFolded.PrintTime();
+        polyScalar.PrintTime();
+        polySimd.PrintTime();
+        poly.PrintTime();
+        cout << format(" └ max |scalar - SIMD|: naive {:.3e}, polyphase {:.3e}\n", naiveSimdError, polySimdError);
+        cout << format(" └ max |scalar - folded|: naive {:.3e}, polyphase {:.3e}\n", naiveFoldedError, polyFoldedError);
+
+        halfBandScalar.PrintTime();
+        halfBandSimd.PrintTime();
+        halfBand.PrintTime();
+        cout << format(" └ max |scalar - SIMD| {:.3e}, max |scalar - folded| {:.3e}\n", halfBandSimdError, halfBandFoldedError);
+
+        if (exportFile && !exportFile->Close())
+        {
+            cout << " ! Failed to write output file !\n";
+        }
     };
 
     CompareRegularVsPolyphase(std::integral_constant<std::size_t, 128>{}, true);
+    CompareRegularVsPolyphase(std::integral_constant<std::size_t, 1024>{}, false);
 }
@@ -19,7 +19,9 @@
 
 #include "Utility.hpp"
 
+#include <algorithm>
 #include <array>
+#include <cstddef>
 
 namespace TRM
 {
@@ -42,12 +44,19 @@ namespace TRM
         if ((Diode_1N4148_IVTable.back().x - Eps12) < v)  [[unlikely]]
             return Diode_1N4148_IVTable.back().y + 1.7408961998 * (v - Diode_1N4148_IVTable.back().x); // Extrapolate
 
-        const auto upper = std::upper_bound(begin(Diode_1N4148_IVTable),
-                                            end(Diode_1N4148_IVTable),
-                                            v,
-                                            [](const double v, const Measurement& m){ return v < m.x; });
-        const auto lower = upper-1;
-        return LinearInterpolation(v, *lower, *upper);
+        // The table is uniform (1 mV steps): the segment is computed from 'v', then moved by a step if the
+        // rounding of the tabulated voltages put it next to the right one (it is never further off).
+        // The same segment as an upper_bound() search, without its chain of mispredicted branches.
+        constexpr std::size_t Last = Diode_1N4148_IVTable.size() - 1;
+        constexpr double X0   = Diode_1N4148_IVTable.front().x;
+        constexpr double Step = (Diode_1N4148_IVTable.back().x - X0) / Last;
+
+        std::size_t lower = std::min(static_cast<std::size_t>((v - X0) / Step), Last - 1);
+        if (lower > 0 && v < Diode_1N4148_IVTable[lower].x)
+            --lower;
+        else if (lower + 1 < Last && !(v < Diode_1N4148_IVTable[lower + 1].x))
+            ++lower;
+        return LinearInterpolation(v, Diode_1N4148_IVTable[lower], Diode_1N4148_IVTable[lower + 1]);
     }
 
     inline double AntiParallel_1N4148_Current(const double v)
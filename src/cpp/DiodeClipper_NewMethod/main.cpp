@@ -16,25 +16,33 @@
  */
 
 #include "AudioFilePrompt.hpp"
+#include "ChunkedRender.hpp"
 #include "NewMethod.hpp"
 #include "TS808Components.hpp"
 #include "Utility.hpp"
-#include "CircleBuffer.hpp"
 #include "FiniteDifferenceMethod.hpp"
+#include "WavStream.hpp"
 
+#include <algorithm>
+#include <array>
 #include <cmath>
-#include <format>
 #include <iostream>
-#include <ranges>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
 
 using namespace std;
 using namespace TRM;
 
-int main()
+int main(const int argc, const char* const* argv)
 {
-    const auto inputFile192 = Prompt<ExistingAudioFile> ("Enter input guitar DI file (192 kHz, > 10 samples, stereo)",
-                                                         AllOf | NonEmpty | Stereo | SampleRate(192'000));
-    inputFile192.printSummary();
+    // --verify renders a chunked run serially too and reports the error at the seams
+    const bool verify = AnswerPromptsAndTakeVerify(argc, argv);
+
+    const auto inputFile192 = Prompt<ExistingWavFile> ("Enter input guitar DI file (192 kHz, > 10 samples, stereo)",
+                                                       AllOf | NonEmpty | Stereo | SampleRate(192'000));
+    inputFile192.PrintSummary();
 
     constexpr std::size_t LeftCh  = 0u;
     constexpr std::size_t RightCh = 1u;
@@ -45,12 +53,13 @@ int main()
 
     constexpr double h = 1. / (48'000);
 
-    auto in48 = inputFile192.samples[LeftCh]  | views::stride(4) | views::transform(ToCorrectVoltage);
-    auto y48  = inputFile192.samples[RightCh] | views::stride(4) | views::transform(ToCorrectVoltage);
-
     cout << " ! Assuming 0 dBFS = " << FullScaleSampleVoltage << " V !\n";
     cout << " ! Assuming Left channel is raw guitar DI, Right channel is 720 Hz high-passed version of Left channel !\n";
 
+    const ChunkedRenderSettings chunking = PromptChunkedRenderSettings(48'000.);
+
+    auto outputFileName = Prompt<string>("Enter output file name: ");
+
     constexpr double Gain = 0.0; // From 0 to 1
     constexpr double VT = 0.02677; // Volts
     constexpr double n  = 1.92;
@@ -59,38 +68,86 @@ int main()
     constexpr double D = 1. / (VT * n);
     constexpr double C = (-2.) * D / Cf;
 
-    CircleBuffer<double, 7> yBuf{};
-    auto LoadY = CreateBufferLoader(yBuf, y48);
-    LoadY(4);
-
-    // Used equation (2.7) for this, therefore less accurate, but it doesn't matter, it is unstable anyway
-    auto derivatives = [&, diff = FiniteDiff<h>{}](const double delta) mutable {
-        const double S = std::sinh(D*delta);
-        const double K = std::cosh(D*delta);
-        const double f0 = A*yBuf.Get<3>() + B*delta + C*S;
-        const double f1 = A*diff.FirstDerivative(yBuf) + f0*(B + C*D*K);
-        const double f2 = A*diff.SecondDerivative(yBuf) + f1*(B + C*D*K) + C*D*D*f0*f0*S;
-        const double f3 = A*diff.ThirdDerivative(yBuf) + f2*(B + C*D*K) + 3*C*D*D*f0*f1*S + C*D*D*D*f0*f0*f0*K;
-        const double f4 = A*diff.FourthDerivative(yBuf) + f3*(B + C*D*K) + 4*C*D*D*f0*f2*S + 6*C*D*D*D*f0*f0*f1*K + 3*C*D*D*f1*f1*S + C*D*D*D*D*f0*f0*f0*f0*S;
-        LoadY(1);
-        return NewMethod::Derivatives{.first = f0, .second = f1, .third = f2, .fourth = f3, .fifth = f4};
+    // Every 4th frame, zeros after the end
+    struct Input48
+    {
+        double in, y;
+    };
+    WavReader reader{inputFile192.path};
+    SlidingWindow<Input48> window;
+    auto NextIn48 = [&]
+    {
+        const auto frame = reader.NextFrame(4);
+        return Input48{ .in = frame.empty() ? 0.0 : ToCorrectVoltage(frame[LeftCh]),
+                        .y  = frame.empty() ? 0.0 : ToCorrectVoltage(frame[RightCh]) };
     };
-    NewMethod::Executor x(h, 0.0, move(derivatives));
+    const auto len48 = (inputFile192.Format().frames + 3) / 4;
 
-    std::vector<double> out;
-    out.reserve(in48.size());
+    // All the derivatives of 'y' the method needs are computed a block ahead, in one sweep. They lag the input
+    // by Latency samples: step k is taken once 'y' is pushed up to sample k + Latency.
+    using Diff = FiniteDiffBlock<h, 7, 0, 1, 2, 3, 4>;
+    constexpr std::size_t BlockSz = 1024;
+    struct YDerivatives
+    {
+        Diff yDiff;
+        std::array<double, BlockSz> yIn;
+        std::array<std::array<double, BlockSz>, 5> dy; // 'y' itself, then its 1st .. 4th derivative
+        std::size_t cur = 0;
+    };
 
-    for (const double d : in48)
+    // Step k goes to dst[0][k - dstBegin]
+    auto MakeProcessor = [&](WindowBuffers<1>& dst, const std::size_t& dstBegin)
     {
-        out.push_back((d + x.DoOneStep()) / FullScaleSampleVoltage);
-    }
+        auto state = std::make_unique<YDerivatives>();
+
+        // Used equation (2.7) for this, therefore less accurate, but it doesn't matter, it is unstable anyway
+        auto derivatives = [&s = *state](const double delta) {
+            const auto& dy = s.dy;
+            const std::size_t cur = s.cur;
+            const double S = std::sinh(D*delta);
+            const double K = std::cosh(D*delta);
+            const double f0 = A*dy[0][cur] + B*delta + C*S;
+            const double f1 = A*dy[1][cur] + f0*(B + C*D*K);
+            const double f2 = A*dy[2][cur] + f1*(B + C*D*K) + C*D*D*f0*f0*S;
+            const double f3 = A*dy[3][cur] + f2*(B + C*D*K) + 3*C*D*D*f0*f1*S + C*D*D*D*f0*f0*f0*K;
+            const double f4 = A*dy[4][cur] + f3*(B + C*D*K) + 4*C*D*D*f0*f2*S + 6*C*D*D*D*f0*f0*f1*K + 3*C*D*D*f1*f1*S + C*D*D*D*D*f0*f0*f0*f0*S;
+            return NewMethod::Derivatives{.first = f0, .second = f1, .third = f2, .fourth = f3, .fifth = f4};
+        };
+
+        return [&, state = std::move(state), x = NewMethod::Executor(h, 0.0, std::move(derivatives)), next = std::optional<std::size_t>{}]
+               (const std::size_t begin, const std::size_t end, const bool warmUp) mutable
+        {
+            if (!next) next = begin;
+            auto& [yDiff, yIn, dy, cur] = *state;
+            while (*next < end + Diff::Latency)
+            {
+                const std::size_t n = std::min<std::size_t>(BlockSz, end + Diff::Latency - *next);
+                for (std::size_t i = 0; i < n; ++i)
+                    yIn[i] = window[*next + i].y;
+                yDiff.Process(std::span{yIn}.first(n), {dy[0].data(), dy[1].data(), dy[2].data(), dy[3].data(), dy[4].data()});
+
+                // dy[.][cur] belongs to step *next + cur - Latency
+                for (cur = *next < begin + Diff::Latency ? std::min(n, begin + Diff::Latency - *next) : 0; cur < n; ++cur)
+                {
+                    const std::size_t k = *next + cur - Diff::Latency;
+                    const double d = window[k].in; // The input of the current step
+                    const double out = (d + x.DoOneStep()) / FullScaleSampleVoltage;
+                    if (!warmUp) dst[0][k - dstBegin] = out;
+                }
+                *next += n;
+            }
+        };
+    };
 
-    AudioFile<double> outputFile;
-    outputFile.setSampleRate(48'000);
-    outputFile.setBitDepth(24);
-    outputFile.setAudioBuffer({move(out)});
-    auto outputFileName = Prompt<string>("Enter output file name: ");
-    if (!outputFile.save(outputFileName))
+    WavWriter outputFile{outputFileName, WavFormat{ .sampleRate = 48'000, .channels = 1, .bitDepth = 24 }};
+    const auto result = RenderInWindows(len48, chunking, verify,
+        [&](const std::size_t begin, const std::size_t end){ window.Slide(begin, end + Diff::Latency, NextIn48); },
+        MakeProcessor,
+        [&](const auto& rendered){ outputFile.Write(rendered[0]); });
+
+    result.Print("new method", 48'000.);
+
+    if (!outputFile.Close())
     {
         cout << " ! Failed to write output file !\n";
     }
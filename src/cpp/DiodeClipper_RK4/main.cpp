@@ -16,23 +16,30 @@
  */
 
 #include "AudioFilePrompt.hpp"
+#include "ChunkedRender.hpp"
 #include "RungeKutta4.hpp"
 #include "TS808Components.hpp"
 #include "Utility.hpp"
+#include "WavStream.hpp"
 
+#include <algorithm>
 #include <cmath>
-#include <format>
 #include <iostream>
-#include <ranges>
+#include <optional>
+#include <string>
+#include <vector>
 
 using namespace std;
 using namespace TRM;
 
-int main ()
+int main (const int argc, const char* const* argv)
 {
-    const auto inputFile192 = Prompt<ExistingAudioFile> ("Enter input guitar DI file (192 kHz, > 10 samples, stereo)",
-                                                         AllOf | NonEmpty | Stereo | SampleRate(192'000));
-    inputFile192.printSummary();
+    // --verify renders a chunked run serially too and reports the error at the seams (like ts808_render)
+    const bool verify = AnswerPromptsAndTakeVerify(argc, argv);
+
+    const auto inputFile192 = Prompt<ExistingWavFile> ("Enter input guitar DI file (192 kHz, > 10 samples, stereo)",
+                                                       AllOf | NonEmpty | Stereo | SampleRate(192'000));
+    inputFile192.PrintSummary();
 
     constexpr std::size_t LeftCh  = 0u;
     constexpr std::size_t RightCh = 1u;
@@ -41,58 +48,92 @@ int main ()
 
     auto ToCorrectVoltage = [](double d){ return (d * FullScaleSampleVoltage); };
 
-    // RK4 will run at 48'000 Hz, therefore we need 96'000 Hz input data
-    auto in96 = inputFile192.samples[LeftCh]  | views::stride(2) | views::transform(ToCorrectVoltage);
-    auto y96  = inputFile192.samples[RightCh] | views::stride(2) | views::transform(ToCorrectVoltage);
-
     cout << " ! Assuming 0 dBFS = " << FullScaleSampleVoltage << " V !\n";
     cout << " ! Assuming Left channel is raw guitar DI, Right channel is 720 Hz high-passed version of Left channel !\n";
 
-    const auto diffIn96File = Prompt<ExistingAudioFile>("Enter guitar DI 1st derivative wav file (96 kHz)",
-                                                        AllOf | NonEmpty | SampleRate(96'000));
-    diffIn96File.printSummary();
+    const auto diffIn96File = Prompt<ExistingWavFile>("Enter guitar DI 1st derivative wav file (96 kHz)",
+                                                      AllOf | NonEmpty | SampleRate(96'000));
+    diffIn96File.PrintSummary();
     constexpr double diffWavScale = 1. / 0.00033;
-    auto diffIn96  = diffIn96File.samples[LeftCh] | views::transform([](double d){ return d * diffWavScale; });
 
-    int cur = 0;
-    auto diffEquationDescriptor = [&]<class T>(const T&, const double x)
+    // RK4 will run at 48'000 Hz, therefore we need 96'000 Hz input data: every 2nd frame of the 192 kHz file
+    struct Input96
     {
-        if constexpr(std::is_same_v<T, RK4::TimeStep>)
-        {
-            cur += 2;
-            return;
-        }
-        else
-        {
-            const int    idx   = cur + static_cast<int>(T::lookahead);
-            const double in    = in96[idx];
-            const double din   = diffIn96[idx];
-            const double y     = y96[idx];
-            const double delta = x - in;
-            return din + (y/Rg - delta/Rf - AntiParallel_1N4148_Current(delta)) / Cf;
-        }
+        double in, din, y;
     };
+    WavReader reader192{inputFile192.path};
+    WavReader readerDiff96{diffIn96File.path};
+    const size_t len96 = (inputFile192.Format().frames + 1) / 2;
 
-    RK4::Executor rk4{std::integral_constant<double, 1. / 48'000>{}, 0.0, std::move(diffEquationDescriptor)};
+    // The inputs are streamed through a sliding window, window[i] is 96 kHz sample i (zeros after the end)
+    SlidingWindow<Input96> window;
+    auto NextIn96 = [&]
+    {
+        const auto frame = reader192.NextFrame(2);
+        const auto diff  = readerDiff96.NextFrame();
+        return Input96{ .in  = frame.empty() ? 0.0 : ToCorrectVoltage(frame[LeftCh]),
+                        .din = diff.empty()  ? 0.0 : diff[LeftCh] * diffWavScale,
+                        .y   = frame.empty() ? 0.0 : ToCorrectVoltage(frame[RightCh]) };
+    };
 
-    vector<double> output48;
-    output48.reserve(inputFile192.samples[LeftCh].size() / 4);
-    output48.push_back(0.0);
-    do
+    // Step 'k' integrates from output sample k-1 to k, reading the 96 kHz inputs from index 2*(k-1)
+    auto MakeRK4 = [&](const size_t firstStep)
     {
-        output48.push_back(rk4.DoOneStep());
-    } while ((cur + 2) < static_cast<int>(in96.size()));
+        auto diffEquationDescriptor = [&, cur = 2 * (static_cast<int>(firstStep) - 1)]<class T>(const T&, const double x) mutable
+        {
+            if constexpr(std::is_same_v<T, RK4::TimeStep>)
+            {
+                cur += 2;
+                return;
+            }
+            else
+            {
+                const auto&  input = window[static_cast<size_t>(cur) + T::lookahead];
+                const double delta = x - input.in;
+                return input.din + (input.y/Rg - delta/Rf - AntiParallel_1N4148_Current(delta)) / Cf;
+            }
+        };
+
+        return RK4::Executor{std::integral_constant<double, 1. / 48'000>{}, 0.0, std::move(diffEquationDescriptor)};
+    };
 
-    while(output48.size() < (in96.size() / 2)) output48.push_back(0.0);
+    const size_t steps = max<size_t>(1, (len96 + 1) / 2 - 1);
 
-    for(double& d : output48) d = d / 10.;
+    // Renders steps begin+1 .. end, step k goes to dst[0][k - 1 - dstBegin]
+    auto MakeProcessor = [&](WindowBuffers<1>& dst, const size_t& dstBegin)
+    {
+        return [&, rk4 = optional<decltype(MakeRK4(1))>{}](const size_t begin, const size_t end, const bool warmUp) mutable
+        {
+            if (!rk4) rk4.emplace(MakeRK4(begin + 1));
+            for (size_t k = begin + 1; k <= end; ++k)
+            {
+                const double y = rk4->DoOneStep();
+                if (!warmUp) dst[0][k - 1 - dstBegin] = y;
+            }
+        };
+    };
+
+    const ChunkedRenderSettings chunking = PromptChunkedRenderSettings(48'000.);
 
-    AudioFile<double> outputFile;
-    outputFile.setSampleRate(48'000);
-    outputFile.setBitDepth(24);
-    outputFile.setAudioBuffer({move(output48)});
     auto outputFileName = Prompt<string>("Enter output file name (op amp output / 10): ");
-    if (!outputFile.save(outputFileName))
+    WavWriter outputFile{outputFileName, WavFormat{ .sampleRate = 48'000, .channels = 1, .bitDepth = 24 }};
+    outputFile.Write(0.0); // Output sample 0 is the initial value
+
+    // Steps 1..steps are rendered window by window
+    const auto result = RenderInWindows(steps, chunking, verify,
+        [&](const size_t begin, const size_t end){ window.Slide(2 * begin, 2 * end + 1, NextIn96); },
+        MakeProcessor,
+        [&](const auto& rendered)
+        {
+            for (const double d : rendered[0])
+                outputFile.Write(d / 10.);
+        });
+    for (size_t k = steps + 1; k < len96 / 2; ++k)
+        outputFile.Write(0.0);
+
+    result.Print("RK4", 48'000., 1);
+
+    if (!outputFile.Close())
     {
         cout << " ! Failed to write output file !\n";
     }
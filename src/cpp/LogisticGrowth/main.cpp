@@ -44,6 +44,8 @@ int main(int argC, char** argVal)
 
     const auto Positive = [](auto x) -> bool { return x > static_cast<decltype(x)>(0); };
 
+    AnswerPromptsFrom(argC, argVal);
+
     const double h  = Prompt<double>("Time step (h > 0): "sv, Positive);
     const double y0 = Prompt<double>("Initial value: "sv);
 
@@ -16,15 +16,19 @@
  */
 
 #include "AudioFilePrompt.hpp"
+#include "ChunkedRender.hpp"
 #include "CircleBuffer.hpp"
 #include "FiniteDifferenceMethod.hpp"
 #include "TS808Components.hpp"
 #include "Utility.hpp"
+#include "WavStream.hpp"
 
 #include <cmath>
-#include <format>
-#include <numeric>
-#include <ranges>
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <span>
+#include <string>
 
 using namespace std;
 using namespace TRM;
@@ -57,70 +61,94 @@ private:
 
 // Calculate the voltage in node 'Y' in the TS808 diode clipper circuit using both
 // backwards Euler and IIR method.
-int main ()
+int main (const int argc, const char* const* argv)
 {
-    auto inputFile48 = Prompt<ExistingAudioFile> ("Enter input guitar DI file (48 kHz, > 10 samples)",
-                                                  AllOf | NonEmpty | SampleRate(48'000));
-    inputFile48.printSummary();
+    // --verify renders a chunked run serially too and reports the error at the seams
+    const bool verify = AnswerPromptsAndTakeVerify(argc, argv);
+
+    const auto inputFile48 = Prompt<ExistingWavFile> ("Enter input guitar DI file (48 kHz, > 10 samples)",
+                                                      AllOf | NonEmpty | SampleRate(48'000));
+    inputFile48.PrintSummary();
 
     constexpr std::size_t LeftCh  = 0u;
     [[maybe_unused]] constexpr std::size_t RightCh = 1u;
 
-    auto& in48 = inputFile48.samples[LeftCh];
-    for(auto& x : in48) x = (10. * x - 4.5);
+    const ChunkedRenderSettings chunking = PromptChunkedRenderSettings(48'000.);
 
-    constexpr double h = 1. / 48'000.;
+    // Both methods run in the same pass over the input
+    const auto eulerFileName = Prompt<string>("Backwards Euler method: ");
+    const auto iirFileName   = Prompt<string>("IIR method: ");
 
-    const auto din48 = [&, diff=FiniteDiff<h>{}]() mutable -> vector<double>
+    // Zeros after the end
+    WavReader reader{inputFile48.path};
+    SlidingWindow<double> window;
+    auto NextIn48 = [&]
     {
-        vector<double> result;
-        result.reserve(in48.size());
-
-        CircleBuffer<double, 7> buf;
-        auto load = CreateBufferLoader(buf, in48);
-        load(4);
-        for ([[maybe_unused]]auto x : in48)
-        {
-            result.push_back(diff.FirstDerivative(buf));
-            load(1);
-        }
-        return result;
-    }();
+        const auto frame = reader.NextFrame();
+        return frame.empty() ? 0.0 : (10. * frame[LeftCh] - 4.5);
+    };
+    const auto len48 = inputFile48.Format().frames;
 
-    const auto len48 = in48.size();
-    vector<double> out48;
-    out48.reserve(len48);
+    constexpr double h = 1. / 48'000.;
+    constexpr double K = 1. / (1. + h / (Cg * Rg));
 
-    auto flush = [&](const string_view prompt)
+    // Sample i of the Euler method goes to dst[0][i - dstBegin], that of the IIR method to dst[1][i - dstBegin].
+    // The stencil is filled from the input (zeros before the start), only the state of the methods needs a pre-roll.
+    auto MakeProcessor = [&](WindowBuffers<2>& dst, const std::size_t& dstBegin)
     {
-        AudioFile<double> outputFile;
-        outputFile.setSampleRate(48'000);
-        outputFile.setBitDepth(24);
-        outputFile.setAudioBuffer({move(out48)});
-        auto outputFileName = Prompt<string>(prompt);
-        if (!outputFile.save(outputFileName))
+        return [&, diff = FiniteDiff<h>{}, buf = CircleBuffer<double, 7>{}, euler = 0.0, iir = IIR_HighPass{-0.909935877261752,  0.954967938630875},
+                started = false](const std::size_t begin, const std::size_t end, const bool warmUp) mutable
         {
-            cout << " ! Failed to write output file !\n";
-        }
-        out48.reserve(len48);
+            if (!started)
+            {
+                // Samples begin-3 .. begin+3
+                for (std::size_t i = begin; i < begin + 7; ++i)
+                    buf.RotateLeft() = i < 3 ? 0.0 : window[i - 3];
+                started = true;
+            }
+
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                const double in48  = buf.Get<3>();
+                const double din48 = diff.FirstDerivative(buf);
+                buf.RotateLeft() = window[i + 4];
+
+                // Backwards Euler method
+                if (i > 0)
+                    euler = euler*K + din48*K*h;
+
+                // IIR method
+                const double y = iir(in48);
+
+                if (!warmUp)
+                {
+                    dst[0][i - dstBegin] = euler;
+                    dst[1][i - dstBegin] = y;
+                }
+            }
+        };
     };
 
-    { // Backwards Euler method
-        constexpr double K = 1. / (1. + h / (Cg * Rg));
-        out48.push_back(0.0);
-        for(unsigned i = 1; i < len48; ++i)
+    const WavFormat outputFormat{ .sampleRate = 48'000, .channels = 1, .bitDepth = 24 };
+    WavWriter eulerFile{eulerFileName, outputFormat};
+    WavWriter iirFile  {iirFileName,   outputFormat};
+
+    const auto result = RenderInWindows<2>(len48, chunking, verify,
+        [&](const std::size_t begin, const std::size_t end){ window.Slide(begin - std::min<std::size_t>(begin, 3), end + 4, NextIn48); },
+        MakeProcessor,
+        [&](const auto& rendered)
         {
-            out48.push_back(out48[i-1]*K + din48[i]*K*h);
-        }
-    }
-    flush("Backwards Euler method: ");
+            eulerFile.Write(rendered[0]);
+            iirFile.Write(rendered[1]);
+        });
 
-    { // IIR method
-        IIR_HighPass iir {-0.909935877261752,  0.954967938630875};
-        for(unsigned i = 0; i < len48; ++i)
+    result.Print("node Y (channel 0: backwards Euler, 1: IIR)", 48'000.);
+
+    for (auto* file : {&eulerFile, &iirFile})
+    {
+        if (!file->Close())
         {
-            out48.push_back(iir(in48[i]));
+            cout << " ! Failed to write output file !\n";
         }
     }
-    flush("IIR method: ");
 }
@@ -19,13 +19,21 @@
 
 #include "Utility.hpp"
 #include "CarryoverBuffer.hpp"
+#include "MirroredRing.hpp"
+#include "SimdFIR.hpp"
 
+#include <algorithm>
 #include <numeric>
 
 namespace TRM
 {
 
-    template<std::size_t ChunkSz, bool OnHeap, class Impl>
+    // Scalar:     one inner product per output
+    // Vectorized: several outputs per pass (SimdFIR.hpp)
+    // Folded:     as Vectorized, symmetric coefficients are multiplied once per mirrored input pair
+    enum class FIRKernel { Scalar, Vectorized, Folded };
+
+    template<std::size_t ChunkSz, bool OnHeap, class Impl, FIRKernel Kernel = FIRKernel::Folded>
     struct FIR_Base
     {
         static_assert(ChunkSz % Impl::SourceSkip == 0);
@@ -37,13 +45,36 @@ namespace TRM
 
         using WorkBuffer = CarryoverBuffer<ChunkSz, TailSz>;
         using SaveBuffer = typename WorkBuffer::SaveBuffer;
+        using Ring       = MirroredRing<double, TailSz, ChunkSz>;
 
-        std::conditional_t<OnHeap, SaveBuffer, WorkBuffer> persistentBuf;
+        // On the stack the history stays in place in a ring, on the heap only the tail is kept
+        // and the window is put together in the caller's work buffer
+        std::conditional_t<OnHeap, SaveBuffer, Ring> persistentBuf;
 
     private:
-        static auto ApplyImpl(auto dst, const WorkBuffer& workBuf) -> decltype(dst)
+        // 'window': the TailSz samples of history followed by the ChunkSz new ones.
+        // A polyphase branch (SourceSkip == 1) has consecutive outputs in one vector,
+        // a decimating filter vectorizes its taps instead.
+        static auto ApplyImpl(auto dst, const double* window) -> decltype(dst) requires (Kernel != FIRKernel::Scalar)
+        {
+            constexpr bool Fold = Kernel == FIRKernel::Folded && Simd::IsSymmetric(Impl::Coeffs);
+            auto Emit = [&dst](std::size_t, const double v)
+            {
+                Impl::OutputOp(*dst, v);
+                dst += 1;
+            };
+            if constexpr (Impl::SourceSkip == 1 && Fold)
+                Simd::FIR_Contiguous(1, ChunkSz, Emit, Simd::FIR_SymmetricBranch{Impl::Coeffs, window});
+            else if constexpr (Impl::SourceSkip == 1)
+                Simd::FIR_Contiguous(1, ChunkSz, Emit, Simd::FIR_Branch{Impl::Coeffs, window});
+            else
+                Simd::FIR_Strided<Fold>(Impl::Coeffs, window, Impl::SourceSkip, ChunkSz / Impl::SourceSkip, Emit);
+            return dst;
+        }
+
+        static auto ApplyImpl(auto dst, const double* window) -> decltype(dst) requires (Kernel == FIRKernel::Scalar)
         {
-            auto it = begin(workBuf);
+            auto it = window;
             for (auto n = ChunkSz/Impl::SourceSkip; n-->0;)
             {
                 Impl::OutputOp(*dst, std::inner_product(begin(Impl::Coeffs), end(Impl::Coeffs), it, 0.0));
@@ -62,7 +93,7 @@ namespace TRM
         }
         auto Apply(auto dst, const WorkBuffer& workBuf) -> decltype(dst) requires (OnHeap)
         {
-            const auto result = ApplyImpl(dst, workBuf);
+            const auto result = ApplyImpl(dst, workBuf.buf.data());
             workBuf.Save(persistentBuf);
             return result;
         }
@@ -70,12 +101,14 @@ namespace TRM
         // Implementation when allocated on stack
         auto Load(auto src) -> decltype(src) requires (!OnHeap)
         {
-            std::copy_n(src, ChunkSz, persistentBuf.Carry());
+            std::copy_n(src, ChunkSz, persistentBuf.Block());
             return src + ChunkSz;
         }
         auto Apply(auto dst) -> decltype(dst) requires (!OnHeap)
         {
-            return ApplyImpl(dst, persistentBuf);
+            const auto result = ApplyImpl(dst, persistentBuf.Window());
+            persistentBuf.Advance(ChunkSz);
+            return result;
         }
     };
 
@@ -198,10 +231,13 @@ struct Name {                                           \
 
         TRM_FIR_IMPL(D4x_Impl, 4, D4x_Coeffs, { d = v; });
 
-        template<std::size_t ChunkSz, bool OnHeap>
-        using D4x = FIR_Base<ChunkSz, OnHeap, D4x_Impl>;
+        // Not Folded by default: for the strided kernel the reversed loads cost more than the saved multiplies
+        template<std::size_t ChunkSz, bool OnHeap, FIRKernel Kernel = FIRKernel::Vectorized>
+        using D4x = FIR_Base<ChunkSz, OnHeap, D4x_Impl, Kernel>;
 
-        template<std::size_t ChunkSz, bool OnHeap>
+        // Folded: the symmetric branches (1 and 3) are folded onto themselves, the mirror image
+        // branches (2 and 4) onto each other, and all four are summed in one pass
+        template<std::size_t ChunkSz, bool OnHeap, FIRKernel Kernel = FIRKernel::Folded>
         class D4x_Poly
         {
             TRM_FIR_IMPL(D4x_Poly_1_Impl, 1, (EveryNth<4, 0>(D4x_Coeffs)), { d  = v; });
@@ -212,10 +248,10 @@ struct Name {                                           \
             static_assert(ChunkSz % 4 == 0);
             TRM_CONSTEXPR std::size_t SubChunkSz = ChunkSz / 4;
 
-            using Poly_1 = FIR_Base<SubChunkSz, OnHeap, D4x_Poly_1_Impl>;
-            using Poly_2 = FIR_Base<SubChunkSz, OnHeap, D4x_Poly_2_Impl>;
-            using Poly_3 = FIR_Base<SubChunkSz, OnHeap, D4x_Poly_3_Impl>;
-            using Poly_4 = FIR_Base<SubChunkSz, OnHeap, D4x_Poly_4_Impl>;
+            using Poly_1 = FIR_Base<SubChunkSz, OnHeap, D4x_Poly_1_Impl, Kernel>;
+            using Poly_2 = FIR_Base<SubChunkSz, OnHeap, D4x_Poly_2_Impl, Kernel>;
+            using Poly_3 = FIR_Base<SubChunkSz, OnHeap, D4x_Poly_3_Impl, Kernel>;
+            using Poly_4 = FIR_Base<SubChunkSz, OnHeap, D4x_Poly_4_Impl, Kernel>;
 
             Poly_1 p1;
             Poly_2 p2;
@@ -242,6 +278,15 @@ struct Name {                                           \
             }
             auto Apply(auto dst, const WorkBuffer& workBuf) -> decltype(dst) requires (OnHeap)
             {
+                if constexpr (Kernel == FIRKernel::Folded)
+                {
+                    const auto result = ApplyFolded(dst, workBuf.buf1.buf.data(), workBuf.buf2.buf.data(), workBuf.buf3.buf.data(), workBuf.buf4.buf.data());
+                    workBuf.buf1.Save(p1.persistentBuf);
+                    workBuf.buf2.Save(p2.persistentBuf);
+                    workBuf.buf3.Save(p3.persistentBuf);
+                    workBuf.buf4.Save(p4.persistentBuf);
+                    return result;
+                }
                 p1.Apply(dst, workBuf.buf1);
                 p2.Apply(dst, workBuf.buf2);
                 p3.Apply(dst, workBuf.buf3);
@@ -252,13 +297,23 @@ struct Name {                                           \
             auto Load(auto src) -> decltype(src) requires (!OnHeap)
             {
                 return LoadImpl(src,
-                                p1.persistentBuf.Carry(),
-                                p2.persistentBuf.Carry(),
-                                p3.persistentBuf.Carry(),
-                                p4.persistentBuf.Carry());
+                                p1.persistentBuf.Block(),
+                                p2.persistentBuf.Block(),
+                                p3.persistentBuf.Block(),
+                                p4.persistentBuf.Block());
             }
             auto Apply(auto dst) -> decltype(dst) requires (!OnHeap)
             {
+                if constexpr (Kernel == FIRKernel::Folded)
+                {
+                    const auto result = ApplyFolded(dst, p1.persistentBuf.Window(), p2.persistentBuf.Window(),
+                                                         p3.persistentBuf.Window(), p4.persistentBuf.Window());
+                    p1.persistentBuf.Advance(SubChunkSz);
+                    p2.persistentBuf.Advance(SubChunkSz);
+                    p3.persistentBuf.Advance(SubChunkSz);
+                    p4.persistentBuf.Advance(SubChunkSz);
+                    return result;
+                }
                 p1.Apply(dst);
                 p2.Apply(dst);
                 p3.Apply(dst);
@@ -266,6 +321,18 @@ struct Name {                                           \
             }
 
         private:
+            static auto ApplyFolded(auto dst, const double* win1, const double* win2, const double* win3, const double* win4) -> decltype(dst)
+            {
+                auto Emit = [&dst](std::size_t, const double v)
+                {
+                    *dst = v;
+                    dst += 1;
+                };
+                Simd::FIR_Polyphase<true, D4x_Poly_1_Impl::Coeffs, D4x_Poly_2_Impl::Coeffs, D4x_Poly_3_Impl::Coeffs, D4x_Poly_4_Impl::Coeffs>(
+                    1, SubChunkSz, Emit, {win1, win2, win3, win4});
+                return dst;
+            }
+
             static auto LoadImpl(auto src, auto buf1, auto buf2, auto buf3, auto buf4) -> decltype(src)
             {
                 auto ReadTo = [&src](auto& it)
@@ -286,6 +353,235 @@ struct Name {                                           \
 
         };
 
+        // Half-band lowpass filters (Kaiser window, beta = 6): every other coefficient is zero, except the
+        // middle one (0.5). The odd polyphase branch is therefore a single tap.
+        // 192 -> 96 kHz: passband 0 - 20 kHz, stopband from 76 kHz (-62.9 dB), the rest is removed by the 2nd stage
+        constexpr auto HB1_Coeffs = std::array{
+                0.0005263918435816748,
+                0.0,
+                -0.0062845065516579195,
+                0.0,
+                0.0255547433892568,
+                0.0,
+                -0.07770894473242052,
+                0.0,
+                0.30791231605124003,
+                0.5,
+                0.30791231605124003,
+                0.0,
+                -0.07770894473242052,
+                0.0,
+                0.0255547433892568,
+                0.0,
+                -0.0062845065516579195,
+                0.0,
+                0.0005263918435816748
+            };
+
+        // 96 -> 48 kHz: passband 0 - 20 kHz (+-0.007 dB), stopband from 28 kHz (-61.6 dB)
+        constexpr auto HB2_Coeffs = std::array{
+                -0.0002058575763922638,
+                0.0,
+                0.0007124692965313363,
+                0.0,
+                -0.0016644865039647898,
+                0.0,
+                0.0032623340717438548,
+                0.0,
+                -0.005758368787909393,
+                0.0,
+                0.009484941721838749,
+                0.0,
+                -0.014926124705464236,
+                0.0,
+                0.02290305407555777,
+                0.0,
+                -0.035098618363147344,
+                0.0,
+                0.055863796994311,
+                0.0,
+                -0.10126598411280192,
+                0.0,
+                0.31669284388969726,
+                0.5,
+                0.31669284388969726,
+                0.0,
+                -0.10126598411280192,
+                0.0,
+                0.055863796994311,
+                0.0,
+                -0.035098618363147344,
+                0.0,
+                0.02290305407555777,
+                0.0,
+                -0.014926124705464236,
+                0.0,
+                0.009484941721838749,
+                0.0,
+                -0.005758368787909393,
+                0.0,
+                0.0032623340717438548,
+                0.0,
+                -0.0016644865039647898,
+                0.0,
+                0.0007124692965313363,
+                0.0,
+                -0.0002058575763922638
+            };
+
+        // 2x decimation by a half-band filter, in two polyphase branches. The even branch is symmetric,
+        // of the odd branch only the middle tap is multiplied (see Simd::FIR_Polyphase).
+        template<std::size_t ChunkSz, bool OnHeap, const auto& Coeffs, FIRKernel Kernel>
+        class HalfBand2x
+        {
+            static_assert(ChunkSz % 2 == 0);
+            static_assert(Coeffs.size() % 4 == 3, "Half-band filters have 4K+3 taps");
+            TRM_CONSTEXPR std::size_t SubChunkSz = ChunkSz / 2;
+
+            TRM_CONSTEXPR auto Even = EveryNth<2, 0>(Coeffs);
+            // Zero padded to the length of the even branch, so that both branches keep the same history
+            TRM_CONSTEXPR auto Odd = []
+            {
+                std::array<double, Even.size()> result{};
+                std::ranges::copy(EveryNth<2, 1>(Coeffs), result.begin());
+                return result;
+            }();
+            TRM_CONSTEXPR std::size_t MiddleTap = Simd::LeadingZeros(Odd);
+
+            using Buffer = CarryoverBuffer<SubChunkSz, Even.size() - 1>;
+            using Ring   = MirroredRing<double, Even.size() - 1, SubChunkSz>;
+
+        public:
+            struct WorkBuffer
+            {
+                Buffer even;
+                Buffer odd;
+            };
+
+            // Implementation when allocated on heap
+            auto Load(auto src, WorkBuffer& workBuf) -> decltype(src) requires (OnHeap)
+            {
+                return LoadImpl(src, workBuf.even.Restore(persistentBuf.even), workBuf.odd.Restore(persistentBuf.odd));
+            }
+            auto Apply(auto dst, const WorkBuffer& workBuf) -> decltype(dst) requires (OnHeap)
+            {
+                const auto result = ApplyImpl(dst, workBuf.even.buf.data(), workBuf.odd.buf.data());
+                workBuf.even.Save(persistentBuf.even);
+                workBuf.odd.Save(persistentBuf.odd);
+                return result;
+            }
+
+            // Implementation when allocated on stack
+            auto Load(auto src) -> decltype(src) requires (!OnHeap)
+            {
+                return LoadImpl(src, persistentBuf.even.Block(), persistentBuf.odd.Block());
+            }
+            auto Apply(auto dst) -> decltype(dst) requires (!OnHeap)
+            {
+                const auto result = ApplyImpl(dst, persistentBuf.even.Window(), persistentBuf.odd.Window());
+                persistentBuf.even.Advance(SubChunkSz);
+                persistentBuf.odd.Advance(SubChunkSz);
+                return result;
+            }
+
+        private:
+            struct SaveBuffer
+            {
+                typename Buffer::SaveBuffer even;
+                typename Buffer::SaveBuffer odd;
+            };
+
+            struct Rings
+            {
+                Ring even;
+                Ring odd;
+            };
+
+            std::conditional_t<OnHeap, SaveBuffer, Rings> persistentBuf;
+
+            // The windows of the two branches, history first
+            static auto ApplyImpl(auto dst, const double* even, const double* odd) -> decltype(dst)
+            {
+                if constexpr (Kernel == FIRKernel::Scalar)
+                {
+                    for (std::size_t j = 0; j < SubChunkSz; ++j)
+                    {
+                        *dst = std::inner_product(begin(Even), end(Even), even + j, 0.0)
+                             + Odd[MiddleTap] * odd[j + MiddleTap];
+                        dst += 1;
+                    }
+                }
+                else
+                {
+                    auto Emit = [&dst](std::size_t, const double v)
+                    {
+                        *dst = v;
+                        dst += 1;
+                    };
+                    Simd::FIR_Polyphase<Kernel == FIRKernel::Folded, Even, Odd>(
+                        1, SubChunkSz, Emit, {even, odd});
+                }
+                return dst;
+            }
+
+            static auto LoadImpl(auto src, auto even, auto odd) -> decltype(src)
+            {
+                for (auto n = SubChunkSz; n-->0;)
+                {
+                    *even++ = *src++;
+                    *odd++  = *src++;
+                }
+                return src;
+            }
+        };
+
+        // 4x decimation in two half-band stages, 192 -> 96 -> 48 kHz. Same interface as D4x and D4x_Poly.
+        // Multiply-adds per output sample: 2 x 11 + 25 (2 x 6 + 13 folded), D4x / D4x_Poly: 105 (53 folded)
+        template<std::size_t ChunkSz, bool OnHeap, FIRKernel Kernel = FIRKernel::Folded>
+        class D4x_HalfBand
+        {
+            static_assert(ChunkSz % 4 == 0);
+
+            using Stage1 = HalfBand2x<ChunkSz,     OnHeap, HB1_Coeffs, Kernel>;
+            using Stage2 = HalfBand2x<ChunkSz / 2, OnHeap, HB2_Coeffs, Kernel>;
+
+            Stage1 s1;
+            Stage2 s2;
+
+        public:
+            struct WorkBuffer
+            {
+                typename Stage1::WorkBuffer buf1;
+                typename Stage2::WorkBuffer buf2;
+                std::array<double, ChunkSz / 2> out96; // Output of the 1st stage
+            };
+
+            // Implementation when allocated on heap
+            auto Load(auto src, WorkBuffer& workBuf) -> decltype(src) requires (OnHeap)
+            {
+                return s1.Load(src, workBuf.buf1);
+            }
+            auto Apply(auto dst, WorkBuffer& workBuf) -> decltype(dst) requires (OnHeap)
+            {
+                s1.Apply(workBuf.out96.begin(), workBuf.buf1);
+                s2.Load(workBuf.out96.cbegin(), workBuf.buf2);
+                return s2.Apply(dst, workBuf.buf2);
+            }
+
+            // Implementation when allocated on stack
+            auto Load(auto src) -> decltype(src) requires (!OnHeap)
+            {
+                return s1.Load(src);
+            }
+            auto Apply(auto dst) -> decltype(dst) requires (!OnHeap)
+            {
+                std::array<double, ChunkSz / 2> out96;
+                s1.Apply(out96.begin());
+                s2.Load(out96.cbegin());
+                return s2.Apply(dst);
+            }
+        };
+
     } // namespace Decimation
 
 } // namespace TRM
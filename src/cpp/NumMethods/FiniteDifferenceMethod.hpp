@@ -17,38 +17,288 @@
 
 #pragma once
 
+#include "MirroredRing.hpp"
+#include "SimdFIR.hpp"
 #include "Stencil.hpp"
+#include "Utility.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <numeric>
+#include <span>
+#include <utility>
 
 namespace TRM
 {
+namespace FiniteDifference
+{
+
+    namespace _Impl
+    {
+        // Exact arithmetic for the weight generation. Only used at compile time, an overflow is a compile error.
+        struct Fraction
+        {
+            long long num = 0;
+            long long den = 1;
+
+            constexpr Fraction (const long long n = 0, const long long d = 1)
+            {
+                const long long g = std::gcd(n, d);
+                num = (d < 0 ? -n : n) / g;
+                den = (d < 0 ? -d : d) / g;
+            }
+
+            friend constexpr Fraction operator+ (const Fraction a, const Fraction b)
+            {
+                const long long l = std::lcm(a.den, b.den);
+                return { a.num * (l / a.den) + b.num * (l / b.den), l };
+            }
+
+            friend constexpr Fraction operator- (const Fraction a, const Fraction b) { return a + Fraction{-b.num, b.den}; }
+
+            friend constexpr Fraction operator* (const Fraction a, const Fraction b)
+            {
+                // Cross-reduced first, to keep the products small
+                const Fraction x{a.num, b.den};
+                const Fraction y{b.num, a.den};
+                return { x.num * y.num, x.den * y.den };
+            }
+
+            friend constexpr Fraction operator/ (const Fraction a, const Fraction b) { return a * Fraction{b.den, b.num}; }
+        };
+
+        // Fornberg's algorithm ("Generation of Finite Difference Formulas on Arbitrarily Spaced Grids", 1988)
+        // for the nodes -Points/2 .. Points/2 around 0. result[m][k] is the weight of node k in the
+        // derivative of order m, for every order the nodes can give (m < Points).
+        template<std::size_t Points>
+        consteval auto FornbergWeights ()
+        {
+            constexpr long long R = static_cast<long long>(Points / 2);
+            auto Node = [](const std::size_t k) { return static_cast<long long>(k) - R; };
+
+            std::array<std::array<Fraction, Points>, Points> c{};
+            c[0][0] = 1;
+            Fraction c1 = 1;
+            long long c4 = Node(0);
+            for (std::size_t i = 1; i < Points; ++i)
+            {
+                Fraction c2 = 1;
+                const long long c5 = c4;
+                c4 = Node(i);
+                for (std::size_t j = 0; j < i; ++j)
+                {
+                    const long long c3 = Node(i) - Node(j);
+                    c2 = c2 * c3;
+                    if (j == i - 1)
+                    {
+                        for (std::size_t m = i; m > 0; --m)
+                            c[m][i] = c1 * (Fraction{static_cast<long long>(m)} * c[m - 1][i - 1] - Fraction{c5} * c[m][i - 1]) / c2;
+                        c[0][i] = Fraction{-c5} * c1 * c[0][i - 1] / c2;
+                    }
+                    for (std::size_t m = i; m > 0; --m)
+                        c[m][j] = (Fraction{c4} * c[m][j] - Fraction{static_cast<long long>(m)} * c[m - 1][j]) / c3;
+                    c[0][j] = Fraction{c4} * c[0][j] / c3;
+                }
+                c1 = c2;
+            }
+            return c;
+        }
+    }
+
+    // Number of points of the central difference of the given derivative order and (even) order of accuracy
+    consteval std::size_t CentralPoints (const std::size_t order, const std::size_t accuracy)
+    {
+        return 2 * ((order + 1) / 2) - 1 + accuracy;
+    }
+
+    // Central difference of the derivative of order 'Order' over 'Points' samples, generated at compile time:
+    //   f^(Order)(x[Points/2]) ~ sum_k Numerators[k] * x[k] / (Denominator * h^Order)
+    // The integer numerators over their common denominator, in the form of the classic tables.
+    // Order 0 is the middle sample itself.
+    template<std::size_t Order, std::size_t Points>
+    struct Central
+    {
+        static_assert(ValidStencilSize<Points> && Order < Points);
+
+        // The error is O(h^Accuracy)
+        TRM_CONSTEXPR std::size_t Accuracy = Points + 1 - 2 * ((Order + 1) / 2);
+
+        TRM_CONSTEXPR double Denominator = []
+        {
+            constexpr auto Weights = _Impl::FornbergWeights<Points>();
+            long long l = 1;
+            for (const auto& w : Weights[Order]) l = std::lcm(l, w.den);
+            return static_cast<double>(l);
+        }();
+
+        TRM_CONSTEXPR std::array<double, Points> Numerators = []
+        {
+            constexpr auto Weights = _Impl::FornbergWeights<Points>();
+            const auto& w = Weights[Order];
+            std::array<double, Points> result{};
+            for (std::size_t k = 0; k < Points; ++k)
+                result[k] = static_cast<double>(w[k].num * (static_cast<long long>(Denominator) / w[k].den));
+            return result;
+        }();
+    };
+
+    // The 7-point tables FiniteDiff was written with
+    static_assert(Central<1, 7>::Numerators == std::array{-1., 9., -45., 0., 45., -9., 1.}         && Central<1, 7>::Denominator == 60.);
+    static_assert(Central<2, 7>::Numerators == std::array{2., -27., 270., -490., 270., -27., 2.}   && Central<2, 7>::Denominator == 180.);
+    static_assert(Central<3, 7>::Numerators == std::array{1., -8., 13., 0., -13., 8., -1.}         && Central<3, 7>::Denominator == 8.);
+    static_assert(Central<4, 7>::Numerators == std::array{-1., 12., -39., 56., -39., 12., -1.}     && Central<4, 7>::Denominator == 6.);
+    static_assert(CentralPoints(1, 6) == 7 && CentralPoints(3, 4) == 7 && Central<3, 7>::Accuracy == 4);
+
+} // namespace FiniteDifference
 
     // 7-point stencil central finite difference method
     template<double h>
     struct FiniteDiff
     {
-        inline constexpr double FirstDerivative(const auto& s) noexcept
+        template<std::size_t Order>
+        inline constexpr double Derivative(const auto& s) noexcept
         {
-            return StencilProduct<-1., 9., -45., 0., 45., -9., 1.>(s) /
-                   (60 * h);
+            using C = FiniteDifference::Central<Order, 7>;
+            constexpr double Scale = []
+            {
+                double scale = C::Denominator;
+                for (std::size_t i = 0; i < Order; ++i) scale *= h;
+                return scale;
+            }();
+            return [&]<std::size_t... I>(std::index_sequence<I...>)
+            {
+                return StencilProduct<C::Numerators[I]...>(s);
+            }(std::make_index_sequence<7>{}) / Scale;
         }
 
-        inline constexpr double SecondDerivative(const auto& s) noexcept
+        inline constexpr double FirstDerivative(const auto& s) noexcept  { return Derivative<1>(s); }
+        inline constexpr double SecondDerivative(const auto& s) noexcept { return Derivative<2>(s); }
+        inline constexpr double ThirdDerivative(const auto& s) noexcept  { return Derivative<3>(s); }
+        inline constexpr double FourthDerivative(const auto& s) noexcept { return Derivative<4>(s); }
+    };
+
+    //------------------------------------------------------------------------
+    //  FiniteDiffBlock
+    //
+    //  Several derivatives (Orders...) of a signal in one sweep over a block,
+    //  with the Points-point central differences of FiniteDifference::Central.
+    //  Central weights are symmetric for even orders and antisymmetric for odd
+    //  ones: the mirrored samples around the middle are added and subtracted
+    //  once, and every order is a few multiply-adds of these pairs. A vector
+    //  of consecutive windows is loaded once for all the orders (Simd::Vec),
+    //  the scale 1 / (Denominator * h^Order) is folded into the weights, zero
+    //  weights are dropped at compile time.
+    //  The central difference needs Latency samples after the point, so the
+    //  outputs lag the input by Latency samples; the history (zeros at first)
+    //  is kept in a MirroredRing across the calls. The vector outputs and the
+    //  one by one tail are summed in the same order, the results do not depend
+    //  on how the signal is split into blocks.
+    //------------------------------------------------------------------------
+    template<double h, std::size_t Points, std::size_t... Orders>
+    class FiniteDiffBlock
+    {
+        static_assert(sizeof...(Orders) > 0);
+        static_assert(ValidStencilSize<Points>);
+
+        TRM_CONSTEXPR std::size_t N = sizeof...(Orders);
+        TRM_CONSTEXPR std::size_t R = Points / 2;
+        TRM_CONSTEXPR std::size_t MaxBlock = 256;
+
+        TRM_CONSTEXPR std::array<std::size_t, N> OrderOf = { Orders... };
+
+        // Weights[i][0] is the weight of the middle sample, Weights[i][k] that of the pair k samples
+        // away from it (the later one, the earlier one has the same weight with the sign of the order)
+        TRM_CONSTEXPR std::array<std::array<double, R + 1>, N> Weights = []
+        {
+            auto Scaled = []<std::size_t Order>()
+            {
+                using C = FiniteDifference::Central<Order, Points>;
+                double scale = C::Denominator;
+                for (std::size_t i = 0; i < Order; ++i) scale *= h;
+
+                std::array<double, R + 1> result{};
+                for (std::size_t k = 0; k <= R; ++k) result[k] = C::Numerators[R + k] / scale;
+                return result;
+            };
+            return std::array<std::array<double, R + 1>, N>{ Scaled.template operator()<Orders>()... };
+        }();
+
+        // Simd::Vec's interface on single samples, for the tail. Multiply-adds are rounded like a vector lane.
+        struct Lane
+        {
+            using Reg = double;
+            static double Zero ()                             { return 0.0; }
+            static double Broadcast (const double d)          { return d; }
+            static double Load (const double* p)              { return *p; }
+            static void Store (double* p, const double r)     { *p = r; }
+            static double Add (const double a, const double b) { return a + b; }
+            static double Sub (const double a, const double b) { return a - b; }
+            static double MulAdd (const double a, const double b, const double c) { return Simd::Vec::MulAddLane(a, b, c); }
+        };
+
+        MirroredRing<double, Points - 1, MaxBlock> history;
+
+    public:
+        TRM_CONSTEXPR std::size_t Latency = R;
+
+        // Pushes the samples of 'in' (any number of them) and writes in.size() outputs of every
+        // order: out[i][m] is the derivative of order Orders...[i] at sample in[m - Latency].
+        void Process(std::span<const double> in, const std::array<double*, N>& out)
         {
-            return StencilProduct<2., -27., 270., -490., 270., -27., 2.>(s) /
-                   (180 * h * h);
+            for (std::size_t done = 0; done < in.size(); done += MaxBlock)
+            {
+                const std::size_t n = std::min(MaxBlock, in.size() - done);
+                std::copy_n(in.data() + done, n, history.Block());
+
+                const double* const win = history.Window();
+                std::size_t m = 0;
+                for (; m + Simd::Vec::Width <= n; m += Simd::Vec::Width)
+                    Step<Simd::Vec>(win + m, out, done + m);
+                for (; m < n; ++m)
+                    Step<Lane>(win + m, out, done + m);
+
+                history.Advance(n);
+            }
         }
 
-        inline constexpr double ThirdDerivative(const auto& s) noexcept
+        // Zero history
+        void Reset() { history.Reset(); }
+
+    private:
+        // Every order at the window starting at 'x' (one vector of windows, or one window), stored at out[i] + pos
+        template<class V>
+        static void Step(const double* const x, const std::array<double*, N>& out, const std::size_t pos)
         {
-            return StencilProduct<1., -8., 13., 0., -13., 8., -1.>(s) /
-                   (8 * h * h * h);
+            using Reg = typename V::Reg;
+            [&]<std::size_t... K>(std::index_sequence<K...>)
+            {
+                const Reg mid = V::Load(x + R);
+                const Reg sums[]  = { V::Add(V::Load(x + R + 1 + K), V::Load(x + R - 1 - K))... };
+                const Reg diffs[] = { V::Sub(V::Load(x + R + 1 + K), V::Load(x + R - 1 - K))... };
+
+                [&]<std::size_t... I>(std::index_sequence<I...>)
+                {
+                    (V::Store(out[I] + pos, Order<V, I>(mid, OrderOf[I] % 2 == 0 ? sums : diffs, std::index_sequence<K...>{})), ...);
+                }(std::make_index_sequence<N>{});
+            }(std::make_index_sequence<R>{});
         }
 
-        inline constexpr double FourthDerivative(const auto& s) noexcept
+        template<class V, std::size_t I, std::size_t... K>
+        static typename V::Reg Order(const typename V::Reg mid, const typename V::Reg* const pairs, std::index_sequence<K...>)
         {
-            return StencilProduct<-1., 12., -39., 56., -39., 12., -1.>(s) /
-                   (6 * h * h * h * h);
+            typename V::Reg acc = V::Zero();
+            if constexpr (Weights[I][0] != 0.0)
+                acc = V::MulAdd(V::Broadcast(Weights[I][0]), mid, acc);
+
+            auto Pair = [&]<std::size_t k>()
+            {
+                if constexpr (Weights[I][k + 1] != 0.0)
+                    acc = V::MulAdd(V::Broadcast(Weights[I][k + 1]), pairs[k], acc);
+            };
+            (Pair.template operator()<K>(), ...);
+            return acc;
         }
     };
 
-} // namespace TRM
\ No newline at end of file
+} // namespace TRM
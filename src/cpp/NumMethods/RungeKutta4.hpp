@@ -19,34 +19,43 @@
 
 #include "RungeKutta4_ODE_Descriptor.hpp"
 
+#include <type_traits>
+#include <utility>
+
 namespace TRM::RK4
 {
 
-    template<double H, ODE_Descriptor ODE>
+    // The state is a double, or an ensemble of N independent systems (e.g. the same circuit with N
+    // different component values) advanced in lockstep, in SIMD lanes: a Lanes<N> (TS808VST/Lanes.hpp)
+    // or any type with the same element-wise arithmetic. The descriptor is then called once per stage
+    // for the whole ensemble, with the N states, and returns the N slopes. Every lane is computed
+    // with the same operations as a scalar Executor.
+    template<double H, class ODE, class State = double>
+        requires ODE_Descriptor<ODE, State>
     class Executor
     {
     public:
-        Executor(std::integral_constant<double, H>, double y0, ODE&& ode)
+        Executor(std::integral_constant<double, H>, State y0, ODE&& ode)
             : y{y0}
             , odeDescriptor{std::move(ode)}
         {}
 
-        double DoOneStep()
+        State DoOneStep()
         {
-            const double k_1 = odeDescriptor(Lookahead<0>{}, y);
-            const double k_2 = odeDescriptor(Lookahead<1>{}, y + .5 * H * k_1);
-            const double k_3 = odeDescriptor(Lookahead<1>{}, y + .5 * H * k_2);
-            const double k_4 = odeDescriptor(Lookahead<2>{}, y + H * k_3);
+            const State k_1 = odeDescriptor(Lookahead<0>{}, y);
+            const State k_2 = odeDescriptor(Lookahead<1>{}, y + .5 * H * k_1);
+            const State k_3 = odeDescriptor(Lookahead<1>{}, y + .5 * H * k_2);
+            const State k_4 = odeDescriptor(Lookahead<2>{}, y + H * k_3);
 
             y += (k_1 + 2.*k_2 + 2.*k_3 + k_4) * H / 6.;
-            odeDescriptor(TimeStep{}, 0.0);
+            odeDescriptor(TimeStep{}, State{});
             return y;
         }
 
-        double GetValue() const { return y; }
+        State GetValue() const { return y; }
 
     private:
-        double y;
+        State y;
         ODE odeDescriptor;
     };
 
@@ -27,12 +27,13 @@ namespace TRM::RK4
 
     struct TimeStep {};
 
-    template<class Type>
-    concept ODE_Descriptor = requires(Type& obj, double y, TimeStep timeStep)
+    // 'State' is double, or e.g. Lanes<N> for an ensemble of N systems integrated in lockstep
+    template<class Type, class State = double>
+    concept ODE_Descriptor = requires(Type& obj, State y, TimeStep timeStep)
     {
-        { obj(Lookahead<0>{}, y) } -> std::convertible_to<double>;
-        { obj(Lookahead<1>{}, y) } -> std::convertible_to<double>;
-        { obj(Lookahead<2>{}, y) } -> std::convertible_to<double>;
+        { obj(Lookahead<0>{}, y) } -> std::convertible_to<State>;
+        { obj(Lookahead<1>{}, y) } -> std::convertible_to<State>;
+        { obj(Lookahead<2>{}, y) } -> std::convertible_to<State>;
         obj(timeStep, y);
     };
 
@@ -0,0 +1,387 @@
+/*
+ * Copyright (C) 2025 Ték Róbert Máté <eppenpontaz@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Stopwatch.hpp"
+#include "TS808Engine.hpp"
+#include "TS808Reference.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <format>
+#include <iostream>
+#include <numbers>
+#include <vector>
+
+using namespace std;
+using namespace TRM;
+
+// Synthetic guitar-like test signal: a few decaying partials, re-plucked every second
+vector<double> CreateTestSignal (const size_t length)
+{
+    vector<double> signal(length);
+    for (size_t i = 0; i < length; ++i)
+    {
+        const double t     = static_cast<double>(i % 48'000) / 48'000.;
+        const double decay = exp(-3. * t);
+        double s = 0.0;
+        for (int k = 1; k <= 5; ++k)
+            s += sin(2. * numbers::pi * 110. * k * t) * decay / k;
+        signal[i] = 0.2 * s;
+    }
+    return signal;
+}
+
+double MaxAbsDifference (const vector<double>& a, const vector<double>& b)
+{
+    double maxDiff = 0.0;
+    for (size_t i = 0; i < min(a.size(), b.size()); ++i)
+        maxDiff = max(maxDiff, abs(a[i] - b[i]));
+    return maxDiff;
+}
+
+int main ()
+{
+    constexpr size_t SignalLength = 48'000 * 20; // 20 seconds
+    constexpr double Gain = 0.7;
+
+    const auto in48 = CreateTestSignal(SignalLength);
+
+    // Original fixed-size processImpl vs. the engine's fixed and streaming paths.
+    // The engines solve the clipping stage exactly here, like the original.
+    auto CompareFixedBlockSize = [&]<size_t BlockSize>(integral_constant<size_t, BlockSize>) -> void
+    {
+        const size_t Blocks = SignalLength / BlockSize;
+
+        vector<double> reference(Blocks * BlockSize), fixed(Blocks * BlockSize), streaming(Blocks * BlockSize);
+
+        {
+            TS808Reference ref;
+            ref.SetGain(Gain);
+            const string label = format("Reference processImpl  (block size = {:4}):", BlockSize);
+            Stopwatch sw{label};
+            for (size_t b = 0; b < Blocks; ++b)
+                ref.Process<BlockSize>(in48.data() + b * BlockSize, reference.data() + b * BlockSize);
+        }
+        {
+            TS808Engine<> engine;
+            engine.SetGain(Gain);
+            engine.SetExactClipping(true);
+            const string label = format("Engine, fixed path     (block size = {:4}):", BlockSize);
+            Stopwatch sw{label};
+            for (size_t b = 0; b < Blocks; ++b)
+                engine.ProcessFixed<BlockSize>(in48.data() + b * BlockSize, fixed.data() + b * BlockSize);
+        }
+        {
+            TS808Engine<> engine;
+            engine.SetGain(Gain);
+            engine.SetExactClipping(true);
+            const string label = format("Engine, streaming path (block size = {:4}):", BlockSize);
+            Stopwatch sw{label};
+            for (size_t b = 0; b < Blocks; ++b)
+                engine.ProcessStreaming(in48.data() + b * BlockSize, streaming.data() + b * BlockSize, BlockSize);
+        }
+
+        cout << format(" └ max |reference - fixed| = {:.3e}, max |reference - streaming| = {:.3e}\n",
+                       MaxAbsDifference(reference, fixed), MaxAbsDifference(reference, streaming));
+    };
+
+    CompareFixedBlockSize(integral_constant<size_t, 32>{});
+    CompareFixedBlockSize(integral_constant<size_t, 64>{});
+    CompareFixedBlockSize(integral_constant<size_t, 128>{});
+    CompareFixedBlockSize(integral_constant<size_t, 256>{});
+    CompareFixedBlockSize(integral_constant<size_t, 512>{});
+    CompareFixedBlockSize(integral_constant<size_t, 1024>{});
+
+    // Block sizes the original implementation rejected (it produced silence for these)
+    vector<double> reference(SignalLength);
+    {
+        TS808Reference ref;
+        ref.SetGain(Gain);
+        for (size_t b = 0; b < SignalLength / 64; ++b)
+            ref.Process<64>(in48.data() + b * 64, reference.data() + b * 64);
+    }
+
+    auto RunArbitraryBlockSizes = [&](const string& scenario, auto nextBlockSize) -> void
+    {
+        vector<double> out(SignalLength);
+        TS808Engine<> engine;
+        engine.SetGain(Gain);
+        engine.SetExactClipping(true);
+        {
+            const string label = format("Engine, {}:", scenario);
+            Stopwatch sw{label};
+            for (size_t pos = 0; pos < SignalLength;)
+            {
+                const size_t n = min(nextBlockSize(), SignalLength - pos);
+                engine.Process(in48.data() + pos, out.data() + pos, n);
+                pos += n;
+            }
+        }
+        cout << format(" └ max |reference - engine| = {:.3e}\n", MaxAbsDifference(reference, out));
+    };
+
+    RunArbitraryBlockSizes("block size = 48",  []{ return size_t{48}; });
+    RunArbitraryBlockSizes("block size = 100", []{ return size_t{100}; });
+    RunArbitraryBlockSizes("block size = 441", []{ return size_t{441}; });
+    RunArbitraryBlockSizes("variable block sizes (1..1500)", [state = 12345u]() mutable {
+        state = state * 1664525u + 1013904223u; // LCG, deterministic
+        return size_t{1} + (state >> 8) % 1500;
+    });
+
+    // Cost of the same duration of audio at the common host sample rates.
+    // The clipping stage always runs at 176.4 - 192 kHz, so higher host rates need less oversampling.
+    for (const double sampleRate : {44'100., 48'000., 88'200., 96'000., 176'400., 192'000.})
+    {
+        constexpr size_t BlockSize = 256;
+        const size_t length = static_cast<size_t>(sampleRate) * 20;
+        const size_t blocks = length / BlockSize;
+
+        vector<double> in(blocks * BlockSize), out(blocks * BlockSize);
+        for (size_t i = 0; i < in.size(); ++i)
+            in[i] = 0.2 * sin(2. * numbers::pi * 110. * static_cast<double>(i) / sampleRate);
+
+        TS808Engine<> engine;
+        engine.Setup(sampleRate);
+        engine.SetGain(Gain);
+
+        const string label = format("Engine, 20 s of audio at {:6} Hz ({}x oversampling):", sampleRate, engine.GetOversamplingFactor());
+        Stopwatch sw{label};
+        for (size_t b = 0; b < blocks; ++b)
+            engine.ProcessFixed<BlockSize>(in.data() + b * BlockSize, out.data() + b * BlockSize);
+    }
+
+    // Channels processed in lockstep vs. one mono engine per channel.
+    // Every channel gets a differently scaled copy of the test signal, each must match its mono rendering.
+    auto CompareChannels = [&]<size_t Channels>(integral_constant<size_t, Channels>) -> void
+    {
+        constexpr size_t BlockSize = 256;
+        const size_t blocks = SignalLength / BlockSize;
+
+        array<vector<double>, Channels> in, mono, multi;
+        for (size_t c = 0; c < Channels; ++c)
+        {
+            in[c].resize(blocks * BlockSize);
+            mono[c].resize(blocks * BlockSize);
+            multi[c].resize(blocks * BlockSize);
+            for (size_t i = 0; i < in[c].size(); ++i)
+                in[c][i] = in48[i] * (1. - 0.15 * static_cast<double>(c));
+        }
+
+        {
+            const string label = format("{} mono engine(s), {} channel(s):", Channels, Channels);
+            Stopwatch sw{label};
+            for (size_t c = 0; c < Channels; ++c)
+            {
+                TS808Engine<> engine;
+                engine.SetGain(Gain);
+                for (size_t b = 0; b < blocks; ++b)
+                    engine.ProcessFixed<BlockSize>(in[c].data() + b * BlockSize, mono[c].data() + b * BlockSize);
+            }
+        }
+        {
+            TS808Engine<Channels> engine;
+            engine.SetGain(Gain);
+            const string label = format("TS808Engine<{}>, {} channel(s):", Channels, Channels);
+            Stopwatch sw{label};
+            for (size_t b = 0; b < blocks; ++b)
+            {
+                array<const double*, Channels> inPtrs;
+                array<double*, Channels> outPtrs;
+                for (size_t c = 0; c < Channels; ++c)
+                {
+                    inPtrs[c]  = in[c].data() + b * BlockSize;
+                    outPtrs[c] = multi[c].data() + b * BlockSize;
+                }
+                engine.template ProcessFixed<BlockSize>(inPtrs.data(), outPtrs.data());
+            }
+        }
+
+        double maxDiff = 0.0;
+        for (size_t c = 0; c < Channels; ++c)
+            maxDiff = max(maxDiff, MaxAbsDifference(mono[c], multi[c]));
+        cout << format(" └ max |mono - multi-channel| = {:.3e}\n", maxDiff);
+    };
+
+    CompareChannels(integral_constant<size_t, 2>{});
+    CompareChannels(integral_constant<size_t, 4>{});
+
+    // Exact clipping stage solve vs. the crossfaded per-gain inverse tables (the default)
+    for (const double gain : {0.0, 0.3, 0.7, 1.0})
+    {
+        constexpr size_t BlockSize = 256;
+        const size_t blocks = SignalLength / BlockSize;
+
+        vector<double> exact(blocks * BlockSize), tables(blocks * BlockSize);
+        auto Run = [&](const bool exactClipping, vector<double>& out)
+        {
+            TS808Engine<> engine;
+            engine.SetGain(gain);
+            engine.SetExactClipping(exactClipping);
+            const string label = format("Engine, {} clipping (gain = {}):", exactClipping ? "exact" : "table", gain);
+            Stopwatch sw{label};
+            for (size_t b = 0; b < blocks; ++b)
+                engine.ProcessFixed<BlockSize>(in48.data() + b * BlockSize, out.data() + b * BlockSize);
+        };
+        Run(true, exact);
+        Run(false, tables);
+        cout << format(" └ max |exact - table| = {:.3e}\n", MaxAbsDifference(exact, tables));
+    }
+
+    // Engine cost per sample at every fast path block size and oversampling factor, the fixed size path vs.
+    // the streaming one. Both run the block in tiles of TS808Engine<>::TileSize samples, so they must produce the same output.
+    for (const double sampleRate : {48'000., 96'000., 192'000.})
+    {
+        const size_t length = static_cast<size_t>(sampleRate) * 10;
+        vector<double> in(length);
+        for (size_t i = 0; i < length; ++i)
+            in[i] = in48[i % in48.size()];
+
+        auto TimeBlockSize = [&]<size_t BlockSize>(integral_constant<size_t, BlockSize>) -> void
+        {
+            const size_t blocks = length / BlockSize;
+            const double samples = static_cast<double>(blocks * BlockSize);
+
+            vector<double> fixed(blocks * BlockSize), streaming(blocks * BlockSize);
+            auto Run = [&](const bool fixedSize, vector<double>& out) -> double
+            {
+                TS808Engine<> engine;
+                engine.Setup(sampleRate);
+                engine.SetGain(Gain);
+                const auto start = chrono::steady_clock::now();
+                for (size_t b = 0; b < blocks; ++b)
+                {
+                    if (fixedSize)
+                        engine.ProcessFixed<BlockSize>(in.data() + b * BlockSize, out.data() + b * BlockSize);
+                    else
+                        engine.ProcessStreaming(in.data() + b * BlockSize, out.data() + b * BlockSize, BlockSize);
+                }
+                return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / samples;
+            };
+            const double fixedNs     = Run(true, fixed);
+            const double streamingNs = Run(false, streaming);
+            cout << format("Engine at {:6} Hz, block size = {:4}: fixed {:6.1f} ns / sample, streaming {:6.1f} ns / sample\n",
+                           sampleRate, BlockSize, fixedNs, streamingNs);
+            cout << format(" └ max |fixed - streaming| = {:.3e}\n", MaxAbsDifference(fixed, streaming));
+        };
+
+        TimeBlockSize(integral_constant<size_t, 32>{});
+        TimeBlockSize(integral_constant<size_t, 64>{});
+        TimeBlockSize(integral_constant<size_t, 128>{});
+        TimeBlockSize(integral_constant<size_t, 256>{});
+        TimeBlockSize(integral_constant<size_t, 512>{});
+        TimeBlockSize(integral_constant<size_t, 1024>{});
+    }
+
+    // Tone coefficient table vs. the interpolation of the fitted poles / zeros it replaces:
+    // coefficient and magnitude response error over a fine sweep of the tone parameter, and the cost of a lookup
+    for (const double sampleRate : {176'400., 192'000.})
+    {
+        const Tone_IIR_Table_Type table = ResampleToneTable(sampleRate);
+        const ToneCoefficientTable coefficientTable{table};
+
+        auto MagnitudeDb = [sampleRate](const IIR_3_2& c, const double freq) {
+            const complex<double> z1 = polar(1.0, -2. * numbers::pi * freq / sampleRate);
+            const complex<double> z2 = z1 * z1;
+            return 20. * log10(abs((c.b0 + c.b1 * z1 + c.b2 * z2) / (1. + c.a1 * z1 + c.a2 * z2)));
+        };
+
+        constexpr size_t ParamSteps = 100'000;
+        double maxCoefDiff = 0.0, maxDbDiff = 0.0;
+        for (size_t k = 0; k <= ParamSteps; ++k)
+        {
+            const double param = static_cast<double>(k) / static_cast<double>(ParamSteps);
+            const IIR_3_2 interpolated = getIIRCoefficients(param, table);
+            const IIR_3_2 looked       = coefficientTable(param);
+            for (const auto member : {&IIR_3_2::b0, &IIR_3_2::b1, &IIR_3_2::b2, &IIR_3_2::a1, &IIR_3_2::a2})
+                maxCoefDiff = max(maxCoefDiff, abs(interpolated.*member - looked.*member));
+            for (double freq = 20.; freq < 20'000.; freq *= 1.1)
+                maxDbDiff = max(maxDbDiff, abs(MagnitudeDb(interpolated, freq) - MagnitudeDb(looked, freq)));
+        }
+
+        constexpr size_t Lookups = 10'000'000;
+        volatile double sink = 0.0; // keeps the lookups from being optimized away
+        {
+            const string label = format("getIIRCoefficients,   {} lookups at {:6} Hz:", Lookups, sampleRate);
+            Stopwatch sw{label};
+            for (size_t k = 0; k < Lookups; ++k)
+                sink = sink + getIIRCoefficients(static_cast<double>(k % 4099) / 4098., table).a2;
+        }
+        {
+            const string label = format("ToneCoefficientTable, {} lookups at {:6} Hz:", Lookups, sampleRate);
+            Stopwatch sw{label};
+            for (size_t k = 0; k < Lookups; ++k)
+                sink = sink + coefficientTable(static_cast<double>(k % 4099) / 4098.).a2;
+        }
+        cout << format(" └ max coefficient error = {:.3e}, max magnitude response error (20 Hz - 20 kHz) = {:.3e} dB\n",
+                       maxCoefDiff, maxDbDiff);
+    }
+
+    // Cost of sample-accurate automation: parameters set once per block vs. a schedule walked per sub-block.
+    // A constant schedule must reproduce the static rendering, the sweeps show the price of actually moving.
+    {
+        constexpr size_t BlockSize = 256;
+        const size_t blocks = SignalLength / BlockSize;
+
+        vector<double> fixedParams(blocks * BlockSize), automated(blocks * BlockSize);
+        auto Run = [&](const string& scenario, vector<double>& out, auto makeAutomation)
+        {
+            TS808Engine<> engine;
+            engine.SetGain(Gain);
+            engine.SetTone(0.5);
+            engine.SetLevel(0.5);
+            const string label = format("Engine, {} (block size = {}):", scenario, BlockSize);
+            Stopwatch sw{label};
+            size_t pos = 0;
+            auto automation = makeAutomation(pos);
+            for (size_t b = 0; b < blocks; ++b)
+            {
+                if constexpr (is_same_v<decltype(automation), TS808Engine<>::NoAutomation>)
+                    engine.ProcessFixed<BlockSize>(in48.data() + b * BlockSize, out.data() + b * BlockSize);
+                else
+                    engine.ProcessFixed<BlockSize>(in48.data() + b * BlockSize, out.data() + b * BlockSize, automation);
+            }
+        };
+
+        // Triangle sweep over the whole range, one period per second
+        auto Sweep = [](const size_t pos) {
+            const double t = static_cast<double>(pos % 48'000) / 48'000.;
+            return t < 0.5 ? 2. * t : 2. - 2. * t;
+        };
+
+        Run("static parameters", fixedParams, [](size_t&) { return TS808Engine<>::NoAutomation{}; });
+        Run("constant automation", automated, [](size_t&) {
+            return [](size_t) { return TS808Engine<>::ParameterValues{ .gain = Gain, .tone = 0.5, .level = 0.5 }; };
+        });
+        cout << format(" └ max |static - constant automation| = {:.3e}\n", MaxAbsDifference(fixedParams, automated));
+
+        Run("gain sweep", automated, [&](size_t& pos) {
+            return [&](const size_t n) { pos += n; return TS808Engine<>::ParameterValues{ .gain = Sweep(pos), .tone = 0.5, .level = 0.5 }; };
+        });
+        Run("tone sweep", automated, [&](size_t& pos) {
+            return [&](const size_t n) { pos += n; return TS808Engine<>::ParameterValues{ .gain = Gain, .tone = Sweep(pos), .level = 0.5 }; };
+        });
+        Run("level sweep", automated, [&](size_t& pos) {
+            return [&](const size_t n) { pos += n; return TS808Engine<>::ParameterValues{ .gain = Gain, .tone = 0.5, .level = Sweep(pos) }; };
+        });
+        Run("gain, tone and level sweep", automated, [&](size_t& pos) {
+            return [&](const size_t n) { pos += n; return TS808Engine<>::ParameterValues{ .gain = Sweep(pos), .tone = Sweep(pos), .level = Sweep(pos) }; };
+        });
+    }
+}
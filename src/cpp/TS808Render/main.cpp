@@ -0,0 +1,321 @@
+/*
+ * Copyright (C) 2025 Ték Róbert Máté <eppenpontaz@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "ChunkedRender.hpp"
+#include "Tracer.hpp" // before TS808Engine.hpp, for the engine's trace zones
+#include "TS808Engine.hpp"
+#include "WavStream.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace TRM;
+
+// Offline renderer: runs WAV files through the TS808 DSP core, no plugin host needed.
+//
+//   ts808_render [--gain G] [--tone T] [--level L] [--jobs N] [--out DIR]
+//                [--chunk SECONDS [--preroll MS] [--verify]] [--trace FILE] input.wav...
+//
+// Gain, tone and level are the normalized [0, 1] plugin parameters.
+// Every input is written to <DIR or input dir>/<input name>_ts808.wav, the files are
+// distributed over N worker threads (default: one per core).
+// With --chunk the files are rendered one after the other instead, each split into chunks
+// that are rendered on the N threads. Every chunk warms up its engine over the preceding
+// pre-roll, --verify also renders serially and reports the error at the seams.
+// --trace writes a Chrome / Perfetto timeline of the engine stages, in builds configured with
+// -DTRM_ENABLE_TRACING=ON (see Utils/Tracer.hpp).
+
+struct RenderSettings
+{
+    double gain  = 0.0;
+    double tone  = 0.5;
+    double level = 0.5;
+    size_t jobs  = max(1u, thread::hardware_concurrency());
+    optional<filesystem::path> outDir;
+    vector<filesystem::path> inputs;
+
+    double chunkSeconds = 0.0; // 0: no chunking
+    double preRollMs    = 100.0;
+    bool verify         = false;
+
+    optional<string> traceFile;
+};
+
+void PrintUsage ()
+{
+    cout << "Usage: ts808_render [--gain G] [--tone T] [--level L] [--jobs N] [--out DIR]\n"
+            "                    [--chunk SECONDS [--preroll MS] [--verify]] [--trace FILE] input.wav...\n"
+            "  --gain, --tone, --level   plugin parameters in [0, 1] (defaults: 0, 0.5, 0.5)\n"
+            "  --jobs                    number of threads (default: number of cores)\n"
+            "  --out                     output directory (default: next to the input)\n"
+            "  --chunk                   split every file into chunks of this length, rendered in parallel\n"
+            "  --preroll                 warm-up before every chunk (default: 100 ms)\n"
+            "  --verify                  compare the chunked rendering with a serial one\n"
+            "  --trace                   write a timeline of the processing stages (tracing builds only)\n";
+}
+
+optional<RenderSettings> ParseArguments (const int argc, const char* const* argv)
+{
+    RenderSettings settings;
+
+    auto ParseNumber = [](const string_view arg, auto& value) -> bool
+    {
+        const auto [ptr, ec] = from_chars(arg.data(), arg.data() + arg.size(), value);
+        return ec == errc{} && ptr == arg.data() + arg.size();
+    };
+    auto ParseParameter = [&](const string_view arg, double& value) -> bool
+    {
+        return ParseNumber(arg, value) && value >= 0.0 && value <= 1.0;
+    };
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const string_view arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+
+        bool ok = true;
+        if      (arg == "--gain"  && hasValue) ok = ParseParameter(argv[++i], settings.gain);
+        else if (arg == "--tone"  && hasValue) ok = ParseParameter(argv[++i], settings.tone);
+        else if (arg == "--level" && hasValue) ok = ParseParameter(argv[++i], settings.level);
+        else if (arg == "--jobs"  && hasValue) ok = ParseNumber(argv[++i], settings.jobs) && settings.jobs > 0;
+        else if (arg == "--out"   && hasValue) settings.outDir = argv[++i];
+        else if (arg == "--chunk"   && hasValue) ok = ParseNumber(argv[++i], settings.chunkSeconds) && settings.chunkSeconds > 0.0;
+        else if (arg == "--preroll" && hasValue) ok = ParseNumber(argv[++i], settings.preRollMs) && settings.preRollMs >= 0.0;
+        else if (arg == "--verify")              settings.verify = true;
+        else if (arg == "--trace"   && hasValue) settings.traceFile = argv[++i];
+        else if (arg.starts_with("--"))        ok = false;
+        else                                   settings.inputs.emplace_back(arg);
+
+        if (!ok)
+        {
+            cout << format(" ! Invalid argument: {} !\n", arg);
+            return nullopt;
+        }
+    }
+
+    if (settings.inputs.empty())
+        return nullopt;
+
+    return settings;
+}
+
+// Feeds the engine the host buffer size it is fastest with. The blocks are aligned to multiples of
+// BlockSize from the start of the file, so a chunk is cut into the same blocks as a serial run.
+// in(pos) and out(pos) are the channels' pointers to sample 'pos', a nullptr output only advances
+// the engine (used for the pre-roll of a chunk).
+template <size_t Channels>
+void RenderRange (TS808Engine<Channels>& engine, auto&& in, auto&& out, const size_t begin, const size_t end)
+{
+    constexpr size_t BlockSize = 1024;
+
+    for (size_t pos = begin, next; pos < end; pos = next)
+    {
+        next = min((pos / BlockSize + 1) * BlockSize, end);
+        const array<const double*, Channels> inBlock = in(pos);
+        const array<double*, Channels> outBlock = out(pos);
+        engine.Process(inBlock.data(), outBlock.data(), next - pos);
+    }
+}
+
+// Returns the error message, or nothing on success
+optional<string> RenderFile (const RenderSettings& settings, const filesystem::path& input, double& audioSeconds, string& report)
+{
+    WavReader reader{input};
+    if (!reader)
+        return "failed to load";
+
+    const WavFormat wavFormat = reader.Format();
+    const size_t channels     = wavFormat.channels;
+    const size_t length       = wavFormat.frames;
+    const double sampleRate   = static_cast<double>(wavFormat.sampleRate);
+
+    ChunkedRenderSettings chunking{ .chunkSize = 0, .preRoll = 0, .threads = 1 };
+    if (settings.chunkSeconds > 0.0)
+    {
+        chunking.chunkSize = max<size_t>(1, static_cast<size_t>(settings.chunkSeconds * sampleRate));
+        chunking.preRoll   = static_cast<size_t>(settings.preRollMs * 1e-3 * sampleRate);
+        chunking.threads   = settings.jobs;
+    }
+
+    const filesystem::path outDir = settings.outDir.value_or(input.parent_path());
+    const filesystem::path output = outDir / (input.stem().string() + "_ts808.wav");
+    WavWriter outputFile{output, wavFormat};
+
+    // The file is streamed through a sliding window per channel, read a frame at a time
+    vector<SlidingWindow<double>> window(channels);
+    vector<double> frames;
+    auto Slide = [&](const size_t begin, const size_t end)
+    {
+        TRM_TRACE_ZONE("load");
+        frames.clear();
+        for (size_t i = window[0].End(); i < end; ++i)
+        {
+            const auto frame = reader.NextFrame();
+            for (size_t c = 0; c < channels; ++c)
+                frames.push_back(frame.empty() ? 0.0 : frame[c]); // A truncated file goes on in silence
+        }
+        for (size_t c = 0; c < channels; ++c)
+            window[c].Slide(begin, end, [&, i = c]() mutable { const double d = frames[i]; i += channels; return d; });
+    };
+
+    auto MakeEngine = [&]<size_t Channels>()
+    {
+        auto engine = make_unique<TS808Engine<Channels>>();
+        engine->Setup(sampleRate);
+        engine->SetGain(settings.gain);
+        engine->SetTone(settings.tone);
+        engine->SetLevel(settings.level);
+        return engine;
+    };
+
+    // Stereo pairs are processed in lockstep, an odd channel out on its own
+    auto MakeProcessor = [&](WindowBuffers<dynamic_extent>& dst, const size_t& dstBegin)
+    {
+        vector<unique_ptr<TS808Engine<2>>> pairs;
+        for (size_t c = 0; c + 1 < channels; c += 2)
+            pairs.push_back(MakeEngine.template operator()<2>());
+        unique_ptr<TS808Engine<1>> single;
+        if (channels % 2 != 0)
+            single = MakeEngine.template operator()<1>();
+
+        return [&, pairs = move(pairs), single = move(single)](const size_t begin, const size_t end, const bool warmUp)
+        {
+            auto Render = [&]<size_t Channels>(TS808Engine<Channels>& engine, const size_t first)
+            {
+                RenderRange<Channels>(engine,
+                    [&](const size_t pos)
+                    {
+                        array<const double*, Channels> in;
+                        for (size_t c = 0; c < Channels; ++c)
+                            in[c] = &window[first + c][pos];
+                        return in;
+                    },
+                    [&](const size_t pos)
+                    {
+                        array<double*, Channels> out{};
+                        if (!warmUp)
+                            for (size_t c = 0; c < Channels; ++c)
+                                out[c] = &dst[first + c][pos - dstBegin];
+                        return out;
+                    },
+                    begin, end);
+            };
+
+            for (size_t p = 0; p < pairs.size(); ++p)
+                Render(*pairs[p], 2 * p);
+            if (single)
+                Render(*single, channels - 1);
+        };
+    };
+
+    const auto result = RenderInWindows<dynamic_extent>(channels, length, chunking, settings.verify, Slide, MakeProcessor,
+        [&](const auto& rendered)
+        {
+            TRM_TRACE_ZONE("save");
+            for (size_t i = 0; i < rendered[0].size(); ++i)
+                for (const auto& channel : rendered)
+                    outputFile.Write(channel[i]);
+        });
+
+    if (result.verify)
+    {
+        for (size_t c = 0; c < channels; ++c)
+        {
+            const SeamError& error = result.errors[c];
+            report += format("\n └ channel {}: {} of {} seam(s) bit-exact, max error {:.3e} at {:.3f} s, {} non-finite sample(s)",
+                             c, error.exactSeams, error.seams, error.maxAbs, static_cast<double>(error.where) / sampleRate, error.nonFinite);
+        }
+    }
+
+    audioSeconds = static_cast<double>(length) / sampleRate;
+
+    if (!outputFile.Close())
+        return format("failed to write {}", output.string());
+
+    return nullopt;
+}
+
+int main (const int argc, const char* const* argv)
+{
+    const auto settings = ParseArguments(argc, argv);
+    if (!settings)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    if (settings->outDir)
+        filesystem::create_directories(*settings->outDir);
+
+    if (settings->traceFile)
+    {
+#ifdef TRM_ENABLE_TRACING
+        Tracer::SetOutputFile(*settings->traceFile);
+#else
+        cout << " ! --trace is ignored, this build has no tracing (configure with -DTRM_ENABLE_TRACING=ON) !\n";
+#endif
+    }
+
+    size_t failures = 0;
+    mutex coutMutex;
+
+    const auto start = chrono::steady_clock::now();
+
+    // Either the files or the chunks of one file are spread over the threads
+    const size_t fileThreads = settings->chunkSeconds > 0.0 ? 1 : settings->jobs;
+
+    ParallelFor(settings->inputs.size(), fileThreads, [&](const size_t i)
+    {
+        const filesystem::path& input = settings->inputs[i];
+
+        const auto fileStart = chrono::steady_clock::now();
+        double audioSeconds = 0.0;
+        string report;
+        const auto error = RenderFile(*settings, input, audioSeconds, report);
+        const chrono::duration<double> elapsed = chrono::steady_clock::now() - fileStart;
+
+        const lock_guard lock{coutMutex};
+        if (error)
+        {
+            ++failures;
+            cout << format(" ! {}: {} !\n", input.string(), *error);
+        }
+        else
+        {
+            cout << format("{}: {:.1f} s of audio in {:.2f} s ({:.1f}x real time){}\n",
+                           input.string(), audioSeconds, elapsed.count(), audioSeconds / elapsed.count(), report);
+        }
+    });
+
+    const chrono::duration<double> total = chrono::steady_clock::now() - start;
+    cout << format("Rendered {} of {} file(s) in {:.2f} s\n",
+                   settings->inputs.size() - failures, settings->inputs.size(), total.count());
+
+    return failures == 0 ? 0 : 2;
+}
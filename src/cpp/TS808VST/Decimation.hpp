@@ -17,7 +17,12 @@
 
 #pragma once
 
+#include "SimdFIR.hpp"
+
+#include <algorithm>
+#include <array>
 #include <numeric>
+#include <type_traits>
 
 namespace TRM
 {
@@ -29,17 +34,31 @@ namespace TRM
         class Poly_Base
         {
         public:
-            inline double Apply(auto end)
+            inline auto Apply(auto end)
             {
+                using T = std::remove_cvref_t<decltype(*end)>;
                 auto beg = end - Taps;
-                return std::inner_product(begin(_coeffs), std::end(_coeffs), beg, 0.0);
+                return std::inner_product(begin(_coeffs), std::end(_coeffs), beg, T{});
             }
+
         protected:
             Poly_Base(const std::array<double, Taps>& _coeffsIn) : _coeffs{_coeffsIn} {}
         private:
             const std::array<double, Taps>& _coeffs;
         };
 
+        // The sum of the polyphase branches P... (e.g. D4x_Poly_1 ... D4x_Poly_4) over the windows starting at first...,
+        // several outputs per pass, see Simd::FIR_Polyphase(). With Fold, the branches' symmetry halves the multiplies.
+        // The samples are double or Lanes<N>, whose N channels are interleaved: emit(m, y) gets channel m % N of output m / N.
+        template<bool Fold, class... P>
+        static void ApplyBlock(const std::size_t count, auto&& emit, const auto*... first)
+        {
+            static_assert(sizeof...(P) == sizeof...(first));
+            constexpr std::size_t Channels = std::max({sizeof(*first) / sizeof(double)...});
+            static_assert(((sizeof(*first) == Channels * sizeof(double)) && ...));
+            Simd::FIR_Polyphase<Fold, P::coeffs...>(Channels, Channels * count, emit, {reinterpret_cast<const double*>(first)...});
+        }
+
         inline static constexpr std::size_t D4x_Poly_Taps = 27;
         inline static constexpr std::size_t D2x_Poly_Taps = 27;
 
@@ -105,7 +124,7 @@ namespace TRM
 
         struct D2x_Poly_1 : public Poly_Base<D2x_Poly_Taps>
         {
-        private:
+        public:
             inline static constexpr std::array<double, D2x_Poly_Taps> coeffs = {{
                 0.0017537939320576863,
                 0.010684659857249475,
@@ -141,7 +160,7 @@ namespace TRM
 
         struct D2x_Poly_2 : public Poly_Base<D2x_Poly_Taps>
         {
-        private:
+        public:
             inline static constexpr std::array<double, D2x_Poly_Taps> coeffs = {{
                 0.007340938089113929,
                 0.0059465192664006445,
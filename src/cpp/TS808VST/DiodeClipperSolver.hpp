@@ -0,0 +1,130 @@
+//------------------------------------------------------------------------
+// Copyright (C) 2025 Ték Róbert Máté <eppenpontaz@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------
+
+#pragma once
+
+#include "1N4148_IVTable.hpp"
+#include "Lanes.hpp"
+
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+namespace TRM
+{
+
+    //------------------------------------------------------------------------
+    //  DiodeClipperSolver
+    //
+    //  Solves  C = x * A + y(x)  for the voltage 'x' across the anti-parallel
+    //  diode pair, where y(x) is the (sparse) 1N4148 I-V table.
+    //  The right hand side is monotonic in x, so for a given A the table turns
+    //  into a sorted key array  key[i] = x[i] * A + y[i].  A only depends on the
+    //  gain and the time step, the keys are rebuilt by SetA() when those change.
+    //
+    //  The search is a branch-free binary search over the keys, padded with +inf
+    //  to a power of two. It always takes log2(KeyCount) steps, the compiler
+    //  turns every step into a compare + conditional move. Segments are stored
+    //  by the index of their upper key, the two out of range segments (below
+    //  the first and above the last key) evaluate to 0 without branching.
+    //------------------------------------------------------------------------
+    class DiodeClipperSolver
+    {
+    public:
+        inline static constexpr const auto& Table = Diode_1N4148_AntiPar_IVTable_SparsePoint5;
+        inline static constexpr std::size_t KeyCount = std::bit_ceil(Table.size());
+
+        DiodeClipperSolver() { SetA(0.0); }
+
+        void SetA(const double newA)
+        {
+            A = newA;
+
+            keys.fill(std::numeric_limits<double>::infinity());
+            for (std::size_t i = 0; i < Table.size(); ++i)
+                keys[i] = std::fma(Table[i].x, A, Table[i].y);
+
+            segments.fill(Segment{});
+            for (std::size_t u = 1; u < Table.size(); ++u)
+            {
+                const Measurement& lower = Table[u - 1];
+                const Measurement& upper = Table[u];
+                segments[u] = Segment{ .key   = keys[u - 1],
+                                       .x     = lower.x,
+                                       .slope = (upper.x - lower.x) / (keys[u] - keys[u - 1]) };
+            }
+        }
+
+        double GetA() const { return A; }
+
+        // Largest C the I-V table covers, the solution is 0 beyond it
+        double GetMaxC() const { return keys[Table.size() - 1]; }
+
+        // Index of the first key greater than 'c', i.e. std::upper_bound
+        std::size_t UpperIndex(const double c) const
+        {
+            std::size_t base = 0;
+            for (std::size_t step = KeyCount / 2; step > 0; step /= 2)
+                base += (keys[base + step - 1] <= c) ? step : 0;
+            return base + ((keys[base] <= c) ? 1 : 0);
+        }
+
+        double operator()(const double _C) const
+        {
+            const double C = std::abs(_C);
+            const Segment& s = segments[UpperIndex(C)];
+            return std::copysign(std::fma(s.slope, C - s.key, s.x), _C);
+        }
+
+        // One lane per channel, the searches are interleaved so their latencies overlap
+        template<std::size_t N>
+        Lanes<N> operator()(const Lanes<N>& _C) const
+        {
+            Lanes<N> C, result;
+            std::array<std::size_t, N> base{};
+            for (std::size_t i = 0; i < N; ++i)
+                C[i] = std::abs(_C[i]);
+
+            for (std::size_t step = KeyCount / 2; step > 0; step /= 2)
+                for (std::size_t i = 0; i < N; ++i)
+                    base[i] += (keys[base[i] + step - 1] <= C[i]) ? step : 0;
+
+            for (std::size_t i = 0; i < N; ++i)
+            {
+                const Segment& s = segments[base[i] + ((keys[base[i]] <= C[i]) ? 1 : 0)];
+                result[i] = std::copysign(std::fma(s.slope, C[i] - s.key, s.x), _C[i]);
+            }
+            return result;
+        }
+
+    private:
+        // Linear interpolation between two neighbouring table entries
+        struct Segment
+        {
+            double key   = 0.0;
+            double x     = 0.0;
+            double slope = 0.0;
+        };
+
+        double A = 0.0;
+        std::array<double, KeyCount> keys{};
+        std::array<Segment, KeyCount + 1> segments{};
+    };
+
+} // namespace TRM
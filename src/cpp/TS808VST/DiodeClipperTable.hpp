@@ -0,0 +1,176 @@
+//------------------------------------------------------------------------
+// Copyright (C) 2025 Ték Róbert Máté <eppenpontaz@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------
+
+#pragma once
+
+#include "DiodeClipperSolver.hpp"
+#include "Lanes.hpp"
+#include "TS808Components.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace TRM
+{
+
+    //------------------------------------------------------------------------
+    //  DiodeClipperInverseTable
+    //
+    //  The solution of  C = x * A + y(x)  for one A, tabulated directly: C -> x.
+    //  The interesting part of C spans ~6 decades (the diode knee sits around
+    //  1e-5 .. 1e-2), so the table is not uniform in C but in the bit pattern of
+    //  C: every octave is split into SubdivisionsPerOctave equal segments.
+    //  The index is the exponent and the top mantissa bits, i.e. a shift, and
+    //  every segment is stored as a line (x = slope * C + intercept).
+    //  Below 2^MinExponent the solution is linear (the diode current is
+    //  negligible), the first segment covers [0, 2^MinExponent) from the origin.
+    //------------------------------------------------------------------------
+    class DiodeClipperInverseTable
+    {
+    public:
+        inline static constexpr int MinExponent = -24;
+        inline static constexpr int MaxExponent = 3; // C < 8 (the whole I-V table)
+        inline static constexpr std::size_t SubdivisionsPerOctave = 32;
+        inline static constexpr std::size_t Size = (MaxExponent - MinExponent) * SubdivisionsPerOctave;
+
+        // Beyond the end of the I-V table the solver gives up (returns 0),
+        // the table holds the last voltage instead.
+        void Build(const DiodeClipperSolver& solver)
+        {
+            const double maxC = std::nextafter(solver.GetMaxC(), 0.0);
+            for (std::size_t k = 0; k < Size; ++k)
+            {
+                const double c0 = (k == 0) ? 0.0 : SegmentStart(k);
+                const double c1 = std::min(SegmentStart(k + 1), maxC);
+                if (c0 >= c1)
+                {
+                    segments[k] = Segment{ .slope = 0.0, .intercept = solver(maxC) };
+                    continue;
+                }
+                const double x0 = solver(c0);
+                const double x1 = solver(c1);
+                const double slope = (x1 - x0) / (c1 - c0);
+                segments[k] = Segment{ .slope = slope, .intercept = x0 - slope * c0 };
+            }
+        }
+
+        // Segment of a non-negative 'C', values beyond the range are clamped to the ends
+        static std::size_t Index(const double C)
+        {
+            const auto k = static_cast<std::int64_t>(std::bit_cast<std::uint64_t>(C) >> Shift) - static_cast<std::int64_t>(Base);
+            return static_cast<std::size_t>(std::clamp<std::int64_t>(k, 0, Size - 1));
+        }
+
+        double operator()(const double C, const std::size_t index) const
+        {
+            return std::fma(segments[index].slope, C, segments[index].intercept);
+        }
+
+    private:
+        inline static constexpr int Shift = 52 - std::countr_zero(SubdivisionsPerOctave);
+        static_assert(std::has_single_bit(SubdivisionsPerOctave));
+
+        inline static const std::uint64_t Base = std::bit_cast<std::uint64_t>(std::ldexp(1.0, MinExponent)) >> Shift;
+
+        static double SegmentStart(const std::size_t k)
+        {
+            return std::bit_cast<double>((Base + k) << Shift);
+        }
+
+        struct Segment
+        {
+            double slope     = 0.0;
+            double intercept = 0.0;
+        };
+
+        std::array<Segment, Size> segments{};
+    };
+
+    //------------------------------------------------------------------------
+    //  DiodeClipperTableCache
+    //
+    //  A bounded set of inverse tables, evenly spread over the gain range and
+    //  built by Setup() (i.e. never on the audio thread). Any gain in between is
+    //  served by crossfading the two neighbouring tables, so gain automation
+    //  costs nothing but the crossfade weight.
+    //  The tables are spaced evenly in 1/A: where the diodes do not conduct the
+    //  solution is C/A, which the crossfade then reproduces exactly.
+    //------------------------------------------------------------------------
+    class DiodeClipperTableCache
+    {
+    public:
+        inline static constexpr std::size_t TableCount = 17;
+
+        // 'h' is the time step of the clipping stage
+        void Setup(const double h)
+        {
+            invA0 = 1. / CalcA(h, 0.0);
+            invA1 = 1. / CalcA(h, 1.0);
+
+            tables.resize(TableCount);
+            DiodeClipperSolver solver;
+            for (std::size_t t = 0; t < TableCount; ++t)
+            {
+                const double invA = std::lerp(invA0, invA1, static_cast<double>(t) / static_cast<double>(TableCount - 1));
+                solver.SetA(1. / invA);
+                tables[t].Build(solver);
+            }
+            SetA(CalcA(h, 0.0));
+        }
+
+        void SetA(const double A)
+        {
+            const double pos = std::clamp((1. / A - invA0) / (invA1 - invA0), 0.0, 1.0) * static_cast<double>(TableCount - 1);
+            lower  = std::min(static_cast<std::size_t>(pos), TableCount - 2);
+            weight = pos - static_cast<double>(lower);
+        }
+
+        static double CalcA(const double h, const double gain)
+        {
+            return (Cf / h) + (1. / (Rf + gain * Rd));
+        }
+
+        double operator()(const double _C) const
+        {
+            const double C = std::abs(_C);
+            const std::size_t index = DiodeClipperInverseTable::Index(C);
+            return std::copysign(std::lerp(tables[lower](C, index), tables[lower + 1](C, index), weight), _C);
+        }
+
+        template<std::size_t N>
+        Lanes<N> operator()(const Lanes<N>& _C) const
+        {
+            Lanes<N> result;
+            for (std::size_t i = 0; i < N; ++i)
+                result[i] = (*this)(_C[i]);
+            return result;
+        }
+
+    private:
+        std::vector<DiodeClipperInverseTable> tables;
+        double invA0 = 0.0;
+        double invA1 = 0.0;
+        std::size_t lower = 0;
+        double weight = 0.0;
+    };
+
+} // namespace TRM
@@ -23,17 +23,53 @@
 
 namespace TRM
 {
+    enum class FIRSymmetry { None, Symmetric, Antisymmetric };
+
+    // Exact comparison: a folded filter must be the same filter
+    template<std::size_t N>
+    consteval FIRSymmetry DetectSymmetry(const std::array<double, N>& c)
+    {
+        bool symmetric = true, antisymmetric = true;
+        for (std::size_t k = 0; k < (N + 1) / 2; ++k)
+        {
+            symmetric     = symmetric     && c[k] ==  c[N - 1 - k];
+            antisymmetric = antisymmetric && c[k] == -c[N - 1 - k];
+        }
+        return symmetric ? FIRSymmetry::Symmetric : antisymmetric ? FIRSymmetry::Antisymmetric : FIRSymmetry::None;
+    }
+
+    // The symmetry of the coefficients is found at compile time. Symmetric (linear phase) and
+    // antisymmetric (e.g. differentiator) kernels add / subtract the mirrored input pairs first,
+    // and multiply once per pair. The zero middle tap of an antisymmetric kernel is skipped.
     template<class...D>
     consteval auto FIR(D&&...d)
     {
         static_assert(sizeof...(D) > 0, "FIR filter must have at least one coefficient");
         static_assert((std::is_same_v<std::remove_cvref_t<D>, double> && ...), "All coefficients must be doubles");
 
-        return [coefs = std::array<double, sizeof...(D)>{{d...}}](auto begIt, const std::size_t size, auto dstIt) constexpr -> void
+        constexpr std::size_t N = sizeof...(D);
+        const std::array<double, N> coefs{{d...}};
+        const FIRSymmetry symmetry = DetectSymmetry(coefs);
+
+        return [coefs, symmetry](auto begIt, const std::size_t size, auto dstIt) constexpr -> void
         {
+            using T = std::remove_cvref_t<decltype(*begIt)>;
             for (std::size_t i = 0; i < size; ++i)
             {
-                *dstIt = std::inner_product(begin(coefs), end(coefs), begIt, 0.0);
+                if (symmetry == FIRSymmetry::None)
+                {
+                    *dstIt = std::inner_product(begin(coefs), end(coefs), begIt, T{});
+                }
+                else
+                {
+                    T acc{};
+                    for (std::size_t k = 0; k < N / 2; ++k)
+                        acc = acc + coefs[k] * (symmetry == FIRSymmetry::Symmetric ? begIt[k] + begIt[N - 1 - k]
+                                                                                   : begIt[k] - begIt[N - 1 - k]);
+                    if (N % 2 == 1 && symmetry == FIRSymmetry::Symmetric)
+                        acc = acc + coefs[N / 2] * begIt[N / 2];
+                    *dstIt = acc;
+                }
                 ++begIt;
                 ++dstIt;
             }
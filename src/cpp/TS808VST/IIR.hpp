@@ -22,25 +22,35 @@
 namespace TRM
 {
 
+    // 'T' is either double or Lanes<N> (N channels filtered in lockstep)
+    template<class T = double>
     class IIR_HighPass
     {
     public:
         IIR_HighPass(double a, double b) : a {a}, b {b} {}
 
-        inline double operator()(double in)
+        void Reset(double newA, double newB)
         {
-            const double bin = b*in;
-            const double out = std::fma(-a, prevOut, -prevBin + bin);
+            prevBin = prevOut = T{};
+            a = newA;
+            b = newB;
+        }
+
+        inline T operator()(const T& in)
+        {
+            using std::fma;
+            const T bin = b*in;
+            const T out = fma(-a, prevOut, -prevBin + bin);
             prevBin  = bin;
             prevOut = out;
             return out;
         }
 
     private:
-        const double a;
-        const double b;
-        double prevBin  = 0.0;
-        double prevOut = 0.0;
+        double a;
+        double b;
+        T prevBin {};
+        T prevOut {};
     };
 
     struct IIR_3_2
@@ -48,6 +58,7 @@ namespace TRM
         double b0, b1, b2, a1, a2;
     };
 
+    template<class T = double>
     class IIR_3_2_Executor
     {
     public:
@@ -58,9 +69,10 @@ namespace TRM
             this->coefs = coefs;
         }
 
-        inline double operator()(double in)
+        inline T operator()(const T& in)
         {
-            const double out = std::fma(coefs.b0, in, std::fma(coefs.b1, z1, std::fma(coefs.b2, z2, -std::fma(coefs.a1, prevOut, std::fma(coefs.a2, prevPrevOut, 0.0)))));
+            using std::fma;
+            const T out = fma(coefs.b0, in, fma(coefs.b1, z1, fma(coefs.b2, z2, -fma(coefs.a1, prevOut, fma(coefs.a2, prevPrevOut, 0.0)))));
             z2 = z1;
             z1 = in;
             prevPrevOut = prevOut;
@@ -70,10 +82,10 @@ namespace TRM
 
     private:
         IIR_3_2 coefs;
-        double z1 = 0.0;
-        double z2 = 0.0;
-        double prevOut = 0.0;
-        double prevPrevOut = 0.0;
+        T z1 {};
+        T z2 {};
+        T prevOut {};
+        T prevPrevOut {};
     };
 
 } // namespace TRM
@@ -0,0 +1,94 @@
+//------------------------------------------------------------------------
+// Copyright (C) 2025 Ték Róbert Máté <eppenpontaz@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+
+namespace TRM
+{
+
+    // N doubles processed in lockstep, e.g. one per audio channel (structure-of-arrays state).
+    // Every operation is a plain fixed-size loop, which the compiler maps onto SIMD registers:
+    // 2 lanes fill an SSE2 / NEON register, 4 lanes an AVX2 register.
+    template<std::size_t N>
+    struct Lanes
+    {
+        static_assert(std::has_single_bit(N), "Lane count must be a power of two");
+
+        alignas(N * sizeof(double)) std::array<double, N> v{};
+
+        constexpr Lanes() = default;
+        constexpr Lanes(const double d) { v.fill(d); }
+
+        constexpr double& operator[](const std::size_t i)       { return v[i]; }
+        constexpr double  operator[](const std::size_t i) const { return v[i]; }
+
+        constexpr Lanes& operator+=(const Lanes& o) { for (std::size_t i = 0; i < N; ++i) v[i] += o.v[i]; return *this; }
+        constexpr Lanes& operator-=(const Lanes& o) { for (std::size_t i = 0; i < N; ++i) v[i] -= o.v[i]; return *this; }
+        constexpr Lanes& operator*=(const Lanes& o) { for (std::size_t i = 0; i < N; ++i) v[i] *= o.v[i]; return *this; }
+        constexpr Lanes& operator/=(const Lanes& o) { for (std::size_t i = 0; i < N; ++i) v[i] /= o.v[i]; return *this; }
+
+        friend constexpr Lanes operator+(Lanes l, const Lanes& r) { return l += r; }
+        friend constexpr Lanes operator-(Lanes l, const Lanes& r) { return l -= r; }
+        friend constexpr Lanes operator*(Lanes l, const Lanes& r) { return l *= r; }
+        friend constexpr Lanes operator/(Lanes l, const Lanes& r) { return l /= r; }
+        friend constexpr Lanes operator-(Lanes l) { for (double& d : l.v) d = -d; return l; }
+    };
+
+    template<class T>
+    constexpr std::size_t LaneCount = 1;
+
+    template<std::size_t N>
+    constexpr std::size_t LaneCount<Lanes<N>> = N;
+
+    template<class T>
+    constexpr bool IsLanes = false;
+
+    template<std::size_t N>
+    constexpr bool IsLanes<Lanes<N>> = true;
+
+    namespace _Impl
+    {
+        template<class T>
+        constexpr double Lane(const T& x, const std::size_t i)
+        {
+            if constexpr (IsLanes<T>) return x[i];
+            else                      return x;
+        }
+    }
+
+    // Keeps std::fma visible next to the overload below for the unqualified fma() calls in TRM
+    using std::fma;
+
+    // Element-wise fused multiply-add, any of the operands may be a scalar
+    template<class A, class B, class C> requires (IsLanes<A> || IsLanes<B> || IsLanes<C>)
+    constexpr auto fma(const A& a, const B& b, const C& c)
+    {
+        constexpr std::size_t N = std::max({LaneCount<A>, LaneCount<B>, LaneCount<C>});
+        Lanes<N> result;
+        for (std::size_t i = 0; i < N; ++i)
+            result[i] = std::fma(_Impl::Lane(a, i), _Impl::Lane(b, i), _Impl::Lane(c, i));
+        return result;
+    }
+
+} // namespace TRM
@@ -0,0 +1,75 @@
+//------------------------------------------------------------------------
+// Copyright (C) 2025 Ték Róbert Máté <eppenpontaz@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+
+namespace TRM
+{
+
+    // History of a block based FIR or stencil: the 'History' latest samples, followed by room for a
+    // block of at most 'MaxBlock' new ones, always in one contiguous window. Filters read the window
+    // in place, without copying the history in and out of a work buffer every block, and without a
+    // modulo per access like a plain ring buffer.
+    //
+    // The blocks are written one after the other, the window slides along the storage. Once it has
+    // slid more than 'Slide' samples, the history is mirrored to the front and the window restarts
+    // from there: one copy of 'History' samples per 'Slide' processed, instead of two per block.
+    // A larger 'Slide' copies less often, but the window then touches more memory before it returns.
+    //
+    //   ring.Block()[0 .. n)      write the next n <= MaxBlock samples
+    //   ring.Window()[0 .. H + n) the History latest samples and the new ones, oldest first
+    //   ring.Advance(n)           the new samples become part of the history
+    template<class T, std::size_t History, std::size_t MaxBlock, std::size_t Slide = MaxBlock>
+    class MirroredRing
+    {
+    public:
+        static_assert(MaxBlock > 0 && Slide > 0);
+
+        inline static constexpr std::size_t WindowSize = History + MaxBlock;
+
+        T*       Window ()       { return buf.data() + start; }
+        const T* Window () const { return buf.data() + start; }
+
+        T* Block () { return Window() + History; }
+
+        void Advance (const std::size_t n)
+        {
+            start += n;
+            if (start > Slide)
+            {
+                std::copy_n(buf.data() + start, History, buf.data());
+                start = 0;
+            }
+        }
+
+        // Zero history
+        void Reset ()
+        {
+            buf.fill(T{});
+            start = 0;
+        }
+
+    private:
+        std::array<T, Slide + WindowSize> buf {};
+        std::size_t start = 0; // <= Slide, so that a whole window always fits behind it
+    };
+
+} // namespace TRM
@@ -0,0 +1,186 @@
+//------------------------------------------------------------------------
+// Copyright (C) 2025 Ték Róbert Máté <eppenpontaz@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <utility>
+
+namespace TRM
+{
+
+    // The clipping stage (and the tone circuit table) is tuned for ~192 kHz.
+    // Chooses the oversampling factor that brings the host sample rate closest to it:
+    // 44.1 / 48 kHz -> 4x, 88.2 / 96 kHz -> 2x, 176.4 / 192 kHz -> 1x
+    constexpr std::size_t OversamplingFactorFor(const double sampleRate)
+    {
+        if (sampleRate < 66'000.)  return 4;
+        if (sampleRate < 132'000.) return 2;
+        return 1;
+    }
+
+    // Weights of 4 consecutive samples x[-1], x[0], x[1], x[2] and their derivatives.
+    // The derivatives are expected in units of 1 / sample period.
+    struct HermiteWeights
+    {
+        std::array<double, 4> x;
+        std::array<double, 4> dx;
+    };
+
+    // Interpolated sample and derivative at 't' in [0, 1] between x[0] and x[1]
+    struct HermitePhase
+    {
+        HermiteWeights sample;
+        HermiteWeights derivative;
+    };
+
+    // Degree 7 Hermite interpolation: the polynomial that goes through the 4 samples
+    // with the given 4 derivatives, evaluated at 't'.
+    constexpr HermitePhase Hermite7(const double t)
+    {
+        constexpr std::size_t N = 8;
+        constexpr std::array<double, 4> Nodes = {-1., 0., 1., 2.};
+        constexpr auto Abs = [](const double d) { return d < 0.0 ? -d : d; };
+
+        // Rows: p(node) = x, p'(node) = dx  --  columns: coefficients of t^j
+        std::array<std::array<double, 2 * N>, N> m{};
+        for (std::size_t k = 0; k < 4; ++k)
+        {
+            double pow = 1.0;
+            for (std::size_t j = 0; j < N; ++j)
+            {
+                m[k][j] = pow;
+                pow *= Nodes[k];
+            }
+            double dpow = 1.0;
+            for (std::size_t j = 1; j < N; ++j)
+            {
+                m[k + 4][j] = static_cast<double>(j) * dpow;
+                dpow *= Nodes[k];
+            }
+        }
+        for (std::size_t k = 0; k < N; ++k)
+            m[k][N + k] = 1.0;
+
+        // Gauss-Jordan elimination with partial pivoting --> right half becomes the inverse
+        for (std::size_t c = 0; c < N; ++c)
+        {
+            std::size_t pivot = c;
+            for (std::size_t r = c + 1; r < N; ++r)
+                if (Abs(m[r][c]) > Abs(m[pivot][c]))
+                    pivot = r;
+            std::swap(m[c], m[pivot]);
+
+            const double p = m[c][c];
+            for (double& v : m[c]) v /= p;
+
+            for (std::size_t r = 0; r < N; ++r)
+            {
+                if (r == c) continue;
+                const double f = m[r][c];
+                for (std::size_t j = 0; j < 2 * N; ++j)
+                    m[r][j] -= f * m[c][j];
+            }
+        }
+
+        // Monomials (and their derivatives) at 't' times the inverse
+        std::array<double, N> mono{}, dmono{};
+        {
+            double pow = 1.0;
+            for (std::size_t j = 0; j < N; ++j)
+            {
+                mono[j] = pow;
+                if (j + 1 < N) dmono[j + 1] = static_cast<double>(j + 1) * pow;
+                pow *= t;
+            }
+        }
+
+        HermitePhase result{};
+        for (std::size_t k = 0; k < N; ++k)
+        {
+            double w = 0.0, dw = 0.0;
+            for (std::size_t j = 0; j < N; ++j)
+            {
+                w  += mono[j]  * m[j][N + k];
+                dw += dmono[j] * m[j][N + k];
+            }
+            (k < 4 ? result.sample.x[k]     : result.sample.dx[k - 4])     = w;
+            (k < 4 ? result.derivative.x[k] : result.derivative.dx[k - 4]) = dw;
+        }
+        return result;
+    }
+
+    // Sanity check against the closed form values at the midpoint
+    static_assert(Hermite7(0.5).sample.x[1]  - 243. / 512. < 1e-12 && 243. / 512. - Hermite7(0.5).sample.x[1]  < 1e-12);
+    static_assert(Hermite7(0.5).sample.dx[0] -   3. / 512. < 1e-12 &&   3. / 512. - Hermite7(0.5).sample.dx[0] < 1e-12);
+
+    // Hermite7(1 - t) is Hermite7(t) mirrored around t = 0.5: the sample weights are reversed, the
+    // derivative weights reversed and negated. The phases t and 1 - t are therefore computed together
+    // from the sums and differences of the mirrored inputs, x[-1] +- x[2] and x[0] +- x[1]:
+    //   Even = xEven . (x[k] + x[3-k])  +  dxOdd  . (dx[k] - dx[3-k])
+    //   Odd  = xOdd  . (x[k] - x[3-k])  +  dxEven . (dx[k] + dx[3-k])
+    //   value(t) = Even + Odd,  value(1 - t) = Even - Odd
+    // for the interpolated sample, and the negative of that at 1 - t for the interpolated derivative.
+    // That is 8 multiplies for both phases instead of 8 for each.
+    struct FoldedHermiteWeights
+    {
+        std::array<double, 2> xEven;
+        std::array<double, 2> xOdd;
+        std::array<double, 2> dxEven;
+        std::array<double, 2> dxOdd;
+    };
+
+    struct FoldedHermitePhase
+    {
+        FoldedHermiteWeights sample;
+        FoldedHermiteWeights derivative;
+    };
+
+    constexpr FoldedHermitePhase FoldHermite(const HermitePhase& phase)
+    {
+        auto Fold = [](const HermiteWeights& w)
+        {
+            FoldedHermiteWeights result{};
+            for (std::size_t k = 0; k < 2; ++k)
+            {
+                result.xEven[k]  = 0.5 * (w.x[k]  + w.x[3 - k]);
+                result.xOdd[k]   = 0.5 * (w.x[k]  - w.x[3 - k]);
+                result.dxEven[k] = 0.5 * (w.dx[k] + w.dx[3 - k]);
+                result.dxOdd[k]  = 0.5 * (w.dx[k] - w.dx[3 - k]);
+            }
+            return result;
+        };
+        return FoldedHermitePhase{ Fold(phase.sample), Fold(phase.derivative) };
+    }
+
+    // The mirror property the folding relies on
+    static_assert([]
+    {
+        constexpr auto Close = [](const double a, const double b) { return a - b < 1e-12 && b - a < 1e-12; };
+        for (const double t : {0.25, 1. / 3., 0.5})
+        {
+            const HermitePhase p = Hermite7(t), q = Hermite7(1. - t);
+            for (std::size_t k = 0; k < 4; ++k)
+                if (!Close(q.sample.x[k], p.sample.x[3 - k])          || !Close(q.sample.dx[k], -p.sample.dx[3 - k]) ||
+                    !Close(q.derivative.x[k], -p.derivative.x[3 - k]) || !Close(q.derivative.dx[k], p.derivative.dx[3 - k]))
+                    return false;
+        }
+        return true;
+    }());
+
+} // namespace TRM
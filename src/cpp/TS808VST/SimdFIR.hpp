@@ -0,0 +1,458 @@
+//------------------------------------------------------------------------
+// Copyright (C) 2025 Ték Róbert Máté <eppenpontaz@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#if defined(__AVX512F__) || defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+    #include <immintrin.h>
+#endif
+
+namespace TRM
+{
+namespace Simd
+{
+
+    //------------------------------------------------------------------------
+    //  Vec
+    //
+    //  The widest double vector of the target (picked at compile time, i.e. by
+    //  -march), with the handful of operations the FIR kernels need.
+    //  AVX-512 and AVX2 multiply-add fused, SSE2 does not. Without SSE2 (e.g.
+    //  ARM) it is a single double and the compiler vectorizes what it can.
+    //  MulAddLane() is one lane of MulAdd(), rounded the same way. It goes
+    //  through the intrinsics too, so that -ffast-math can not reassociate it.
+    //------------------------------------------------------------------------
+#if defined(__AVX512F__)
+    struct Vec
+    {
+        using Reg = __m512d;
+        inline static constexpr std::size_t Width = 8;
+
+        static Reg Zero ()                          { return _mm512_setzero_pd(); }
+        static Reg Broadcast (const double d)       { return _mm512_set1_pd(d); }
+        static Reg Load (const double* p)           { return _mm512_loadu_pd(p); }
+        static void Store (double* p, const Reg r)  { _mm512_storeu_pd(p, r); }
+        static Reg Add (const Reg a, const Reg b)   { return _mm512_add_pd(a, b); }
+        static Reg Sub (const Reg a, const Reg b)   { return _mm512_sub_pd(a, b); }
+        static Reg MulAdd (const Reg a, const Reg b, const Reg c) { return _mm512_fmadd_pd(a, b, c); }
+        static double Sum (const Reg r)
+        {
+            // Through memory: GCC 12 warns about the uninitialized upper halves in the lane extracting intrinsics
+            alignas(64) double v[Width];
+            _mm512_store_pd(v, r);
+            return ((v[0] + v[4]) + (v[2] + v[6])) + ((v[1] + v[5]) + (v[3] + v[7]));
+        }
+        static double MulAddLane (const double a, const double b, const double c)
+        {
+            return _mm_cvtsd_f64(_mm_fmadd_sd(_mm_set_sd(a), _mm_set_sd(b), _mm_set_sd(c)));
+        }
+        static Reg Reverse (const Reg r)
+        {
+#if defined(__GNUC__)
+            // GCC 12 warns about the uninitialized pass-through operand of the permute intrinsics
+            return __builtin_shufflevector(r, r, 7, 6, 5, 4, 3, 2, 1, 0);
+#else
+            return _mm512_permutexvar_pd(_mm512_set_epi64(0, 1, 2, 3, 4, 5, 6, 7), r);
+#endif
+        }
+    };
+#elif defined(__AVX2__) && defined(__FMA__)
+    struct Vec
+    {
+        using Reg = __m256d;
+        inline static constexpr std::size_t Width = 4;
+
+        static Reg Zero ()                          { return _mm256_setzero_pd(); }
+        static Reg Broadcast (const double d)       { return _mm256_set1_pd(d); }
+        static Reg Load (const double* p)           { return _mm256_loadu_pd(p); }
+        static void Store (double* p, const Reg r)  { _mm256_storeu_pd(p, r); }
+        static Reg Add (const Reg a, const Reg b)   { return _mm256_add_pd(a, b); }
+        static Reg Sub (const Reg a, const Reg b)   { return _mm256_sub_pd(a, b); }
+        static Reg Reverse (const Reg r)            { return _mm256_permute4x64_pd(r, 0b00'01'10'11); }
+        static Reg MulAdd (const Reg a, const Reg b, const Reg c) { return _mm256_fmadd_pd(a, b, c); }
+        static double Sum (const Reg r)
+        {
+            const __m128d half = _mm_add_pd(_mm256_castpd256_pd128(r), _mm256_extractf128_pd(r, 1));
+            return _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+        }
+        static double MulAddLane (const double a, const double b, const double c)
+        {
+            return _mm_cvtsd_f64(_mm_fmadd_sd(_mm_set_sd(a), _mm_set_sd(b), _mm_set_sd(c)));
+        }
+    };
+#elif defined(__SSE2__) || defined(_M_X64)
+    struct Vec
+    {
+        using Reg = __m128d;
+        inline static constexpr std::size_t Width = 2;
+
+        static Reg Zero ()                          { return _mm_setzero_pd(); }
+        static Reg Broadcast (const double d)       { return _mm_set1_pd(d); }
+        static Reg Load (const double* p)           { return _mm_loadu_pd(p); }
+        static void Store (double* p, const Reg r)  { _mm_storeu_pd(p, r); }
+        static Reg Add (const Reg a, const Reg b)   { return _mm_add_pd(a, b); }
+        static Reg Sub (const Reg a, const Reg b)   { return _mm_sub_pd(a, b); }
+        static Reg Reverse (const Reg r)            { return _mm_shuffle_pd(r, r, 1); }
+        static Reg MulAdd (const Reg a, const Reg b, const Reg c) { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+        static double Sum (const Reg r)             { return _mm_cvtsd_f64(_mm_add_sd(r, _mm_unpackhi_pd(r, r))); }
+        static double MulAddLane (const double a, const double b, const double c)
+        {
+            return _mm_cvtsd_f64(_mm_add_sd(_mm_mul_sd(_mm_set_sd(a), _mm_set_sd(b)), _mm_set_sd(c)));
+        }
+    };
+#else
+    struct Vec
+    {
+        using Reg = double;
+        inline static constexpr std::size_t Width = 1;
+
+        static Reg Zero ()                          { return 0.0; }
+        static Reg Broadcast (const double d)       { return d; }
+        static Reg Load (const double* p)           { return *p; }
+        static void Store (double* p, const Reg r)  { *p = r; }
+        static Reg Add (const Reg a, const Reg b)   { return a + b; }
+        static Reg Sub (const Reg a, const Reg b)   { return a - b; }
+        static Reg Reverse (const Reg r)            { return r; }
+        static Reg MulAdd (const Reg a, const Reg b, const Reg c) { return a * b + c; }
+        static double Sum (const Reg r)             { return r; }
+        static double MulAddLane (const double a, const double b, const double c) { return a * b + c; }
+    };
+#endif
+
+    //------------------------------------------------------------------------
+    //  Coefficient symmetry, detected at compile time
+    //
+    //  Linear-phase FIRs have symmetric coefficients: c[k] == c[Taps-1-k]. The
+    //  mirrored input pairs can be added first and multiplied once, halving the
+    //  multiplies. Polyphase branches of a symmetric filter are either symmetric
+    //  themselves or the mirror image of another branch.
+    //  The comparisons are exact: the folded filter is the same filter.
+    //------------------------------------------------------------------------
+    template<std::size_t Taps>
+    consteval bool IsSymmetric (const std::array<double, Taps>& c)
+    {
+        for (std::size_t k = 0; k < Taps / 2; ++k)
+            if (c[k] != c[Taps - 1 - k]) return false;
+        return true;
+    }
+
+    template<std::size_t Taps>
+    consteval bool IsMirrorImage (const std::array<double, Taps>& a, const std::array<double, Taps>& b)
+    {
+        for (std::size_t k = 0; k < Taps; ++k)
+            if (a[k] != b[Taps - 1 - k]) return false;
+        return true;
+    }
+
+    // Zero coefficients at the ends are dropped: the padding of shorter polyphase branches,
+    // and the zero taps of a half-band filter, whose odd branch is a single tap.
+    template<std::size_t Taps>
+    consteval std::size_t LeadingZeros (const std::array<double, Taps>& c)
+    {
+        std::size_t n = 0;
+        while (n < Taps && c[n] == 0.0) ++n;
+        return n;
+    }
+
+    // Number of coefficients without the leading and trailing zeros
+    template<std::size_t Taps>
+    consteval std::size_t TrimmedSize (const std::array<double, Taps>& c)
+    {
+        std::size_t size = Taps;
+        while (size > LeadingZeros(c) && c[size - 1] == 0.0) --size;
+        return size - LeadingZeros(c);
+    }
+
+    template<const auto& Coeffs>
+    inline constexpr auto Trimmed = []
+    {
+        std::array<double, TrimmedSize(Coeffs)> result{};
+        for (std::size_t k = 0; k < result.size(); ++k) result[k] = Coeffs[LeadingZeros(Coeffs) + k];
+        return result;
+    }();
+
+    // One FIR of an FIR_Contiguous() call: 'coeffs' over the samples starting at 'x'
+    template<std::size_t Taps>
+    struct FIR_Branch
+    {
+        const std::array<double, Taps>& coeffs;
+        const double* x;
+    };
+
+    // A branch with symmetric coefficients, multiplied once per mirrored input pair
+    template<std::size_t Taps>
+    struct FIR_SymmetricBranch
+    {
+        const std::array<double, Taps>& coeffs;
+        const double* x;
+    };
+
+    // Two branches whose coefficients are each other's mirror image: 'coeffs' over the samples starting
+    // at 'x', plus the reversed 'coeffs' over the samples starting at 'xMirrored'. One multiply per tap pair.
+    template<std::size_t Taps>
+    struct FIR_MirroredBranches
+    {
+        const std::array<double, Taps>& coeffs;
+        const double* x;
+        const double* xMirrored;
+    };
+
+    // f(c, x0, x1) for every multiply of a branch: c * (x0[m] + x1[m]), or c * x0[m] where x1 is nullptr
+    template<std::size_t Taps>
+    inline void ForEachTap (const FIR_Branch<Taps>& b, const std::size_t tapStride, auto&& f)
+    {
+        for (std::size_t k = 0; k < Taps; ++k)
+            f(b.coeffs[k], b.x + k * tapStride, nullptr);
+    }
+
+    template<std::size_t Taps>
+    inline void ForEachTap (const FIR_SymmetricBranch<Taps>& b, const std::size_t tapStride, auto&& f)
+    {
+        for (std::size_t k = 0; k < Taps / 2; ++k)
+            f(b.coeffs[k], b.x + k * tapStride, b.x + (Taps - 1 - k) * tapStride);
+        if constexpr (Taps % 2 == 1)
+            f(b.coeffs[Taps / 2], b.x + (Taps / 2) * tapStride, nullptr);
+    }
+
+    template<std::size_t Taps>
+    inline void ForEachTap (const FIR_MirroredBranches<Taps>& b, const std::size_t tapStride, auto&& f)
+    {
+        for (std::size_t k = 0; k < Taps; ++k)
+            f(b.coeffs[k], b.x + k * tapStride, b.xMirrored + (Taps - 1 - k) * tapStride);
+    }
+
+    //------------------------------------------------------------------------
+    //  FIR_Contiguous
+    //
+    //  y[m] = sum_b sum_k b.coeffs[k] * b.x[m + k * tapStride],  m = 0 .. count-1
+    //  (folded accordingly for FIR_SymmetricBranch and FIR_MirroredBranches)
+    //
+    //  Consecutive outputs share a vector: every coefficient is broadcast once
+    //  and multiplied into Unroll independent accumulators, i.e. Unroll * Width
+    //  outputs are computed per pass instead of one long dependent add chain.
+    //  'tapStride' > 1 serves interleaved channels (Lanes<N> frames).
+    //  Several branches (e.g. the polyphase branches of a decimator) are summed
+    //  in the same multiply-add chain, branch by branch, tap by tap. Every output,
+    //  vector or scalar tail, is summed in this order, so the result does not
+    //  depend on where a block starts.
+    //  emit(m, y[m]) is called for every m, in order.
+    //------------------------------------------------------------------------
+    template<class... Branches>
+    inline void FIR_Contiguous (const std::size_t tapStride, const std::size_t count, auto&& emit,
+                                const Branches&... branches)
+    {
+        constexpr std::size_t W = Vec::Width;
+        constexpr std::size_t Unroll = 4;
+
+        std::size_t m = 0;
+        auto Pass = [&]<std::size_t U>()
+        {
+            typename Vec::Reg acc[U];
+            for (std::size_t u = 0; u < U; ++u) acc[u] = Vec::Zero();
+            auto Branch = [&](const auto& b)
+            {
+                ForEachTap(b, tapStride, [&](const double c, const double* x0, const auto x1)
+                {
+                    for (std::size_t u = 0; u < U; ++u)
+                    {
+                        typename Vec::Reg x = Vec::Load(x0 + m + u * W);
+                        if constexpr (!std::is_null_pointer_v<decltype(x1)>)
+                            x = Vec::Add(x, Vec::Load(x1 + m + u * W));
+                        acc[u] = Vec::MulAdd(Vec::Broadcast(c), x, acc[u]);
+                    }
+                });
+            };
+            (Branch(branches), ...);
+
+            double y[U * W];
+            for (std::size_t u = 0; u < U; ++u) Vec::Store(y + u * W, acc[u]);
+            for (std::size_t i = 0; i < U * W; ++i) emit(m + i, y[i]);
+            m += U * W;
+        };
+
+        while (m + Unroll * W <= count) Pass.template operator()<Unroll>();
+        while (m + W <= count)          Pass.template operator()<1>();
+        for (; m < count; ++m)
+        {
+            double acc = 0.0;
+            auto Branch = [&](const auto& b)
+            {
+                ForEachTap(b, tapStride, [&](const double c, const double* x0, const auto x1)
+                {
+                    if constexpr (std::is_null_pointer_v<decltype(x1)>) acc = Vec::MulAddLane(c, x0[m], acc);
+                    else                                                acc = Vec::MulAddLane(c, x0[m] + x1[m], acc);
+                });
+            };
+            (Branch(branches), ...);
+            emit(m, acc);
+        }
+    }
+
+    namespace _Impl
+    {
+        inline constexpr std::size_t NoMirror = static_cast<std::size_t>(-1);
+
+        template<std::size_t A, std::size_t B>
+        consteval bool IsMirrorImage (const std::array<double, A>& a, const std::array<double, B>& b)
+        {
+            if constexpr (A != B) return false;
+            else                  return Simd::IsMirrorImage(a, b);
+        }
+
+        template<std::size_t I, const auto&... Coeffs>
+        constexpr const auto& NthTrimmed ()
+        {
+            return std::get<I>(std::tie(Trimmed<Coeffs>...));
+        }
+
+        template<std::size_t I, const auto&... Coeffs, std::size_t... J>
+        consteval std::size_t FirstMirrorImage (std::index_sequence<J...>)
+        {
+            std::size_t result = NoMirror;
+            ((result = (result == NoMirror && J != I &&
+                        IsMirrorImage(NthTrimmed<I, Coeffs...>(), NthTrimmed<J, Coeffs...>())) ? J : result), ...);
+            return result;
+        }
+
+        // Branch I itself if its (trimmed) coefficients are symmetric, otherwise the first other
+        // branch that is its mirror image, NoMirror if there is none
+        template<std::size_t I, const auto&... Coeffs>
+        consteval std::size_t MirrorBranch ()
+        {
+            if (IsSymmetric(NthTrimmed<I, Coeffs...>()))
+                return I;
+            return FirstMirrorImage<I, Coeffs...>(std::make_index_sequence<sizeof...(Coeffs)>{});
+        }
+    }
+
+    //------------------------------------------------------------------------
+    //  FIR_Polyphase
+    //
+    //  The sum of polyphase branches, branch p being Coeffs[p] over the samples
+    //  starting at x[p], through FIR_Contiguous(). The zero coefficients at the
+    //  ends of the branches are dropped at compile time (x[p] is advanced past
+    //  the leading ones). With Fold, symmetric branches are folded onto
+    //  themselves and mirror image branches onto each other. Polyphase
+    //  decomposition mostly breaks the symmetry of the prototype filter, but the
+    //  branches of a symmetric prototype always come in one of these two forms.
+    //------------------------------------------------------------------------
+    template<bool Fold, const auto&... Coeffs>
+    inline void FIR_Polyphase (const std::size_t tapStride, const std::size_t count, auto&& emit,
+                               const std::array<const double*, sizeof...(Coeffs)>& x)
+    {
+        using _Impl::NoMirror;
+        using _Impl::MirrorBranch;
+
+        // The first sample of branch I that meets a non-zero coefficient
+        auto First = [&]<std::size_t I>() { return x[I] + LeadingZeros(std::get<I>(std::tie(Coeffs...))) * tapStride; };
+
+        auto Branch = [&]<std::size_t I>()
+        {
+            constexpr std::size_t J = Fold ? MirrorBranch<I, Coeffs...>() : NoMirror;
+            const auto& c = _Impl::NthTrimmed<I, Coeffs...>();
+            if constexpr (J == NoMirror)
+                return std::tuple{ FIR_Branch{c, First.template operator()<I>()} };
+            else if constexpr (MirrorBranch<J, Coeffs...>() != I)
+                return std::tuple{ FIR_Branch{c, First.template operator()<I>()} };
+            else if constexpr (J == I)
+                return std::tuple{ FIR_SymmetricBranch{c, First.template operator()<I>()} };
+            else if constexpr (J > I)
+                return std::tuple{ FIR_MirroredBranches{c, First.template operator()<I>(), First.template operator()<J>()} };
+            else
+                return std::tuple{}; // Folded into branch J
+        };
+
+        [&]<std::size_t... I>(std::index_sequence<I...>)
+        {
+            std::apply([&](const auto&... branches) { FIR_Contiguous(tapStride, count, emit, branches...); },
+                       std::tuple_cat(Branch.template operator()<I>()...));
+        }(std::make_index_sequence<sizeof...(Coeffs)>{});
+    }
+
+    //------------------------------------------------------------------------
+    //  FIR_Strided
+    //
+    //  y[j] = sum_k coeffs[k] * x[j * outStride + k],  j = 0 .. count-1
+    //
+    //  For decimating filters (outStride > 1) consecutive outputs are not
+    //  consecutive in x, the taps are vectorized instead: Outputs outputs at a
+    //  time, each in its own accumulator, share the coefficient loads.
+    //  Symmetric coefficients are folded: the mirrored half of the window is
+    //  loaded reversed and added before the multiply. The folded half is padded
+    //  to whole vectors with zeros (and a halved middle tap, which is then added
+    //  to itself), so that there is no scalar tail.
+    //  emit(j, y[j]) is called for every j, in order.
+    //------------------------------------------------------------------------
+    template<bool Symmetric = false, std::size_t Taps>
+    inline void FIR_Strided (const std::array<double, Taps>& coeffs, const double* x, const std::size_t outStride,
+                             const std::size_t count, auto&& emit)
+    {
+        constexpr std::size_t W = Vec::Width;
+        constexpr std::size_t Folded  = (Taps + 1) / 2;
+        constexpr std::size_t VecTaps = Symmetric ? (Folded + W - 1) / W * W : Taps - Taps % W;
+        constexpr std::size_t Outputs = 4;
+        static_assert(!Symmetric || VecTaps <= Taps, "Too few taps to fold");
+
+        std::array<double, VecTaps> foldedCoeffs{};
+        if constexpr (Symmetric)
+        {
+            for (std::size_t k = 0; k < Taps / 2; ++k) foldedCoeffs[k] = coeffs[k];
+            if constexpr (Taps % 2 == 1) foldedCoeffs[Taps / 2] = 0.5 * coeffs[Taps / 2];
+        }
+        const double* c = Symmetric ? foldedCoeffs.data() : coeffs.data();
+
+        std::size_t j = 0;
+        auto Pass = [&]<std::size_t N>()
+        {
+            typename Vec::Reg acc[N];
+            for (std::size_t o = 0; o < N; ++o) acc[o] = Vec::Zero();
+            for (std::size_t k = 0; k < VecTaps; k += W)
+            {
+                const typename Vec::Reg ck = Vec::Load(c + k);
+                for (std::size_t o = 0; o < N; ++o)
+                {
+                    const double* window = x + (j + o) * outStride;
+                    typename Vec::Reg in = Vec::Load(window + k);
+                    if constexpr (Symmetric)
+                        in = Vec::Add(in, Vec::Reverse(Vec::Load(window + Taps - W - k)));
+                    acc[o] = Vec::MulAdd(ck, in, acc[o]);
+                }
+            }
+            for (std::size_t o = 0; o < N; ++o)
+            {
+                const double* window = x + (j + o) * outStride;
+                double y = Vec::Sum(acc[o]);
+                if constexpr (!Symmetric)
+                    for (std::size_t k = VecTaps; k < Taps; ++k)
+                        y = Vec::MulAddLane(coeffs[k], window[k], y);
+                emit(j + o, y);
+            }
+            j += N;
+        };
+
+        while (j + Outputs <= count) Pass.template operator()<Outputs>();
+        while (j < count)            Pass.template operator()<1>();
+    }
+
+} // namespace Simd
+} // namespace TRM
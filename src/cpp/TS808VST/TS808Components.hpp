@@ -24,6 +24,7 @@ namespace TRM
 
     inline constexpr double Rf = 51'000.;  // Feedback resistor   (51k)
     inline constexpr double Cf = 51.e-12;  // Feedback capacitor  (51pF)
+    inline constexpr double Cg = 0.047e-6; // Ground capacitor    (0.047uF)
     inline constexpr double Rg = 4700.;    // Ground resistor     (4k7)
     inline constexpr double Rd = 500'000.; // Drive potentiometer (500k)
 
@@ -0,0 +1,562 @@
+//------------------------------------------------------------------------
+// Copyright (C) 2025 Ték Róbert Máté <eppenpontaz@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------
+
+#pragma once
+
+#include "TS808Components.hpp"
+#include "Decimation.hpp"
+#include "DiodeClipperSolver.hpp"
+#include "DiodeClipperTable.hpp"
+#include "IIR.hpp"
+#include "FIR.hpp"
+#include "Lanes.hpp"
+#include "MirroredRing.hpp"
+#include "Oversampling.hpp"
+#include "Tone_IIR_Table.hpp"
+
+#include <cmath>
+#include <array>
+#include <algorithm>
+#include <numeric>
+#include <type_traits>
+#include <utility>
+
+// Profiling zones of the processing stages, recorded when Utils/Tracer.hpp is included first
+// (and TRM_ENABLE_TRACING is defined). The plugin does not trace.
+#ifndef TRM_TRACE_ZONE
+    #define TRM_TRACE_ZONE(name)
+#endif
+
+namespace TRM {
+
+#define CLIP
+#define TONE
+
+//------------------------------------------------------------------------
+//  TS808Engine
+//
+//  Host-independent DSP core: input -> Nx upsampling -> clipping stage
+//  -> tone circuit -> Nx decimation -> output.
+//  N is chosen by Setup() so that the clipping stage runs at 176.4 - 192 kHz.
+//  Blocks of any length can be fed to Process(), the filter and ODE state is
+//  carried over between calls. No heap allocation happens while processing.
+//
+//  'Channels' independent channels are processed in lockstep: every state
+//  variable is a Lanes<Channels> (one lane per channel), so the filters,
+//  the interpolator and the decimator run on SIMD registers.
+//------------------------------------------------------------------------
+template <std::size_t Channels = 1>
+class TS808Engine
+{
+public:
+    static_assert(Channels >= 1);
+
+    // One time step of every channel
+    using Frame = std::conditional_t<Channels == 1, double, Lanes<Channels>>;
+
+    inline static constexpr std::size_t MaxOversampling = 4;
+
+    // Blocks are processed in tiles of this many input samples: every stage runs over the
+    // tile before the next one starts, so the intermediate buffers (~5 KB per channel at 4x oversampling)
+    // stay in L1 instead of being streamed through it once per stage.
+    inline static constexpr std::size_t TileSize = 32;
+
+    TS808Engine () { Setup (48'000.); }
+
+    // Derives every sample rate dependent coefficient and resets the processing state.
+    void Setup (const double sampleRate)
+    {
+        oversampling       = OversamplingFactorFor(sampleRate);
+        inputSampleRate    = sampleRate;
+        internalSampleRate = sampleRate * static_cast<double>(oversampling);
+        h                  = 1. / internalSampleRate;
+
+        // Phase p and oversampling-2-p are mirror images, only the first half is stored
+        for (std::size_t p = 0; p < oversampling / 2; ++p)
+            interpolationPhases[p] = FoldHermite(Hermite7(static_cast<double>(p + 1) / static_cast<double>(oversampling)));
+
+        // Bilinear transform of the Rg-Cg high-pass
+        const double K = 2. * internalSampleRate * Rg * Cg;
+        clippingStageHP.Reset((1. - K) / (1. + K), K / (1. + K));
+
+        // Allocates, Setup() must not be called from the audio thread
+        clipperTables.Setup(h);
+        UpdateClipperSolver();
+
+        toneCoefficients = ToneCoefficientTable(ResampleToneTable(internalSampleRate));
+        toneCircuit      = IIR_3_2_Executor<Frame>{toneCoefficients(lastToneParameter)};
+
+        prevClippingStageOut = Frame{};
+        meters = Meters{};
+        prev_in.Reset();
+        prev_din.Reset();
+        for (auto& prev : prev_poly) prev.Reset();
+    }
+
+    std::size_t GetOversamplingFactor () const { return oversampling; }
+    double GetInternalSampleRate () const { return internalSampleRate; }
+
+    void SetGain (const double g)
+    {
+        if (g != gain)
+        {
+            gain = g;
+            UpdateClipperSolver();
+        }
+    }
+    void SetLevel (const double l) { level = l; }
+    void SetTone (const double tone)
+    {
+        if (tone != lastToneParameter)
+        {
+            toneCircuit.UpdateCoefs(toneCoefficients(tone));
+            lastToneParameter = tone;
+        }
+    }
+
+    // The clipping stage uses the per-gain inverse tables by default (O(1) per sample),
+    // the exact solve of the sparse I-V table is kept as a reference.
+    void SetExactClipping (const bool exact)
+    {
+        exactClipping = exact;
+        if (exact)
+            clipperSolver.SetA(DiodeClipperTableCache::CalcA(h, gain));
+    }
+
+    // Sample-accurate automation. When an 'automation' callable is passed to Process(), it is called as
+    //   ParameterValues automation (std::size_t numSamples)
+    // before every sub-block of (at most) AutomationSubBlockSize samples, in order, and returns the
+    // parameter values reached at the end of that sub-block. Gain and tone change per sub-block (the
+    // tone coefficients are lerped between the 0.001 grid points of ToneCoefficientTable, ~1e-7 off the
+    // pole / zero interpolation), level is ramped per sample.
+    struct ParameterValues
+    {
+        double gain;
+        double tone;
+        double level;
+    };
+
+    inline static constexpr std::size_t AutomationSubBlockSize = 16;
+
+    // Parameters stay at the values given to the setters
+    struct NoAutomation {};
+
+    // Signal meters, the maxima over every channel since the previous TakeMeters() call
+    struct Meters
+    {
+        double inputPeak        = 0.0; // |input sample|
+        double outputPeak       = 0.0; // |output sample|
+        double diodeVoltagePeak = 0.0; // |voltage across the clipping diodes| in V, 0 while they are off
+    };
+
+    Meters TakeMeters () { return std::exchange(meters, Meters{}); }
+
+    // 'in' and 'out' point to 'Channels' channel buffers of 'numSamples' samples each.
+    // Output channels given as nullptr are processed but not written.
+    template <class Sample, class Automation = NoAutomation>
+    void Process (const Sample* const* in, Sample* const* out, std::size_t numSamples, Automation&& automation = {})
+    {
+        // Fast paths for the usual host buffer sizes
+        switch(numSamples)
+        {
+            case 32:   ProcessFixed<32>(in, out, automation);   return;
+            case 64:   ProcessFixed<64>(in, out, automation);   return;
+            case 128:  ProcessFixed<128>(in, out, automation);  return;
+            case 256:  ProcessFixed<256>(in, out, automation);  return;
+            case 512:  ProcessFixed<512>(in, out, automation);  return;
+            case 1024: ProcessFixed<1024>(in, out, automation); return;
+            default: break;
+        }
+
+        ProcessStreaming(in, out, numSamples, automation);
+    }
+
+    template <std::size_t BlockSize, class Sample, class Automation = NoAutomation>
+    void ProcessFixed (const Sample* const* in, Sample* const* out, Automation&& automation = {})
+    {
+        constexpr std::size_t Tile = std::min(BlockSize, TileSize);
+        static_assert(BlockSize % Tile == 0);
+
+        WithOversampling([&]<std::size_t Factor>()
+        {
+            for (std::size_t offset = 0; offset < BlockSize; offset += Tile)
+                ProcessImpl<Factor, Tile>(in, out, offset, std::integral_constant<std::size_t, Tile>{}, automation);
+        });
+    }
+
+    template <class Sample, class Automation = NoAutomation>
+    void ProcessStreaming (const Sample* const* in, Sample* const* out, const std::size_t numSamples, Automation&& automation = {})
+    {
+        WithOversampling([&]<std::size_t Factor>()
+        {
+            for (std::size_t offset = 0; offset < numSamples; offset += TileSize)
+                ProcessImpl<Factor, TileSize>(in, out, offset, std::min(numSamples - offset, TileSize), automation);
+        });
+    }
+
+    // Single channel shorthands
+    template <class Sample, class Automation = NoAutomation> requires (Channels == 1)
+    void Process (const Sample* in, Sample* out, std::size_t numSamples, Automation&& automation = {})
+    {
+        Process(&in, &out, numSamples, automation);
+    }
+
+    template <std::size_t BlockSize, class Sample, class Automation = NoAutomation> requires (Channels == 1)
+    void ProcessFixed (const Sample* in, Sample* out, Automation&& automation = {})
+    {
+        ProcessFixed<BlockSize>(&in, &out, automation);
+    }
+
+    template <class Sample, class Automation = NoAutomation> requires (Channels == 1)
+    void ProcessStreaming (const Sample* in, Sample* out, std::size_t numSamples, Automation&& automation = {})
+    {
+        ProcessStreaming(&in, &out, numSamples, automation);
+    }
+
+private:
+    inline static constexpr std::size_t DecimatorTaps = Decimation::D4x_Poly_Taps;
+    static_assert(Decimation::D2x_Poly_Taps == DecimatorTaps);
+    static_assert(TileSize % AutomationSubBlockSize == 0, "Sub-blocks must not straddle tiles");
+
+    void WithOversampling (auto&& f)
+    {
+        switch(oversampling)
+        {
+            case 4:  f.template operator()<4>(); break;
+            case 2:  f.template operator()<2>(); break;
+            default: f.template operator()<1>(); break;
+        }
+    }
+
+    // The diode equation's linear term depends on the gain and the time step. Called per sub-block
+    // under gain automation: the solver's keys and segments are only rebuilt when it is in use.
+    void UpdateClipperSolver ()
+    {
+        const double A = DiodeClipperTableCache::CalcA(h, gain);
+        clipperTables.SetA(A);
+        if (exactClipping)
+            clipperSolver.SetA(A);
+    }
+
+    static double& Lane (Frame& f, [[maybe_unused]] const std::size_t c)
+    {
+        if constexpr (Channels == 1) return f;
+        else                         return f[c];
+    }
+
+    static double Lane (const Frame& f, [[maybe_unused]] const std::size_t c)
+    {
+        if constexpr (Channels == 1) return f;
+        else                         return f[c];
+    }
+
+    // Element-wise max(peak, |x|)
+    static Frame Peak (Frame peak, const Frame& x)
+    {
+        for (std::size_t c = 0; c < Channels; ++c)
+            Lane(peak, c) = std::max(Lane(peak, c), std::abs(Lane(x, c)));
+        return peak;
+    }
+
+    static double MaxLane (const Frame& f)
+    {
+        double result = Lane(f, 0);
+        for (std::size_t c = 1; c < Channels; ++c)
+            result = std::max(result, Lane(f, c));
+        return result;
+    }
+
+    // Processes samples [offset, offset + count) of every channel, 'count' <= Capacity.
+    // 'count' is either a std::size_t or an std::integral_constant, the latter lets
+    // the fixed size paths unroll freely.
+    template <std::size_t Factor, std::size_t Capacity, class Sample, class Automation>
+    void ProcessImpl (const Sample* const* input, Sample* const* output, std::size_t offset, const auto count, Automation& automation);
+
+    double gain  = 0.0;
+    double level = 0.5;
+
+    std::size_t oversampling  = 4;
+    double inputSampleRate    = 48'000.;
+    double internalSampleRate = 192'000.;
+    double h                  = 1. / 192'000.; // Time step of the clipping stage
+
+    std::array<FoldedHermitePhase, MaxOversampling/2> interpolationPhases{};
+
+    bool exactClipping = false;
+    DiodeClipperSolver clipperSolver;
+    DiodeClipperTableCache clipperTables;
+
+    Frame prevClippingStageOut {};
+
+    // The input, its derivative and the polyphase branches of the decimator's input stay in place
+    // between blocks, every block is written right behind its history (see MirroredRing).
+    // Sliding over a few tiles keeps what the window touches small.
+    template <std::size_t History>
+    using HistoryRing = MirroredRing<Frame, History, TileSize, 4 * TileSize>;
+
+    HistoryRing<6> prev_in;
+    HistoryRing<3> prev_din;
+
+    std::array<HistoryRing<DecimatorTaps-1>, MaxOversampling> prev_poly;
+
+    TRM::IIR_HighPass<Frame> clippingStageHP {-0.976696930369159, 0.988348465184579};
+    ToneCoefficientTable toneCoefficients = Tone_IIR_CoefficientTable;
+    TRM::IIR_3_2_Executor<Frame> toneCircuit {Tone_IIR_CoefficientTable(0.5)};
+    double lastToneParameter = 0.5;
+
+    Meters meters;
+};
+
+//------------------------------------------------------------------------
+template <std::size_t Channels>
+template <std::size_t Factor, std::size_t Capacity, class Sample, class Automation>
+void TS808Engine<Channels>::ProcessImpl (const Sample* const* input, Sample* const* output, const std::size_t offset, const auto count, [[maybe_unused]] Automation& automation)
+{
+    using namespace std;
+
+    constexpr bool Automated = !is_same_v<remove_cvref_t<Automation>, NoAutomation>;
+    constexpr size_t SubBlock = AutomationSubBlockSize;
+
+    constexpr double FullScaleSampleVoltage = 3.88;
+
+    static_assert(Capacity <= TileSize);
+
+    // Input samples, behind the last 6
+    const Frame* const inBuf = [&]
+    {
+        TRM_TRACE_ZONE("TS808 input");
+        Frame* const in = prev_in.Block();
+        for (size_t c = 0; c < Channels; ++c)
+            for (size_t i = 0; i < count; ++i)
+                Lane(in[i], c) = static_cast<double>(input[c][offset + i]);
+
+        Frame peak {};
+        for (size_t i = 0; i < count; ++i)
+            peak = Peak(peak, in[i]);
+        meters.inputPeak = max(meters.inputPeak, MaxLane(peak));
+        return prev_in.Window();
+    }();
+
+    // Input derivatives, in units of 1 / input sample period, behind the last 3
+    const Frame* const dinBuf = [&]
+    {
+        TRM_TRACE_ZONE("TS808 derivative");
+        constexpr double r = 1. / 60.;
+        constexpr auto diff_kernel = FIR(-1.*r, 9.*r, -45.*r, 0.0, 45.*r, -9.*r, 1.*r);
+        diff_kernel(inBuf, count, prev_din.Block());
+        return prev_din.Window();
+    }();
+
+    struct SampleAndDerivative
+    {
+        Frame sample {};
+        Frame derivative {};
+    };
+
+    // Oversampled input + derivatives (in units of 1 / second)
+    const auto inUp = [&]() -> array<SampleAndDerivative, Factor * Capacity>
+    {
+        TRM_TRACE_ZONE("TS808 upsample");
+        array<SampleAndDerivative, Factor * Capacity> inUp;
+
+        // The even and odd part of a folded phase, see FoldedHermiteWeights
+        auto Apply = [](const FoldedHermiteWeights& w, const auto& xSum, const auto& xDiff,
+                        const auto& dxSum, const auto& dxDiff) -> pair<Frame, Frame> {
+            const Frame even = w.xEven[0] * xSum[0] + w.xEven[1] * xSum[1] + w.dxOdd[0]  * dxDiff[0] + w.dxOdd[1]  * dxDiff[1];
+            const Frame odd  = w.xOdd[0] * xDiff[0] + w.xOdd[1] * xDiff[1] + w.dxEven[0] * dxSum[0]  + w.dxEven[1] * dxSum[1];
+            return {even, odd};
+        };
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            auto dst = [cur = i * Factor, &inUp](size_t r) -> SampleAndDerivative& { return inUp[cur + r]; };
+
+            const Frame* x  = &inBuf[i];
+            const Frame* dx = &dinBuf[i];
+            const array<Frame, 2> xSum   { x[0] + x[3],   x[1] + x[2]   };
+            const array<Frame, 2> xDiff  { x[0] - x[3],   x[1] - x[2]   };
+            const array<Frame, 2> dxSum  { dx[0] + dx[3], dx[1] + dx[2] };
+            const array<Frame, 2> dxDiff { dx[0] - dx[3], dx[1] - dx[2] };
+
+            for (size_t p = 0; p < Factor / 2; ++p)
+            {
+                const FoldedHermitePhase& phase = interpolationPhases[p];
+                const auto [sEven, sOdd] = Apply(phase.sample,     xSum, xDiff, dxSum, dxDiff);
+                const auto [dEven, dOdd] = Apply(phase.derivative, xSum, xDiff, dxSum, dxDiff);
+
+                const size_t q = Factor - 2 - p; // the mirror image phase
+                if (p == q)
+                {
+                    // t = 0.5: the odd part of the sample and the even part of the derivative are 0
+                    dst(p).sample     = sEven;
+                    dst(p).derivative = dOdd * inputSampleRate;
+                }
+                else
+                {
+                    dst(p).sample     = sEven + sOdd;
+                    dst(q).sample     = sEven - sOdd;
+                    dst(p).derivative = (dEven + dOdd) * inputSampleRate;
+                    dst(q).derivative = (dOdd - dEven) * inputSampleRate;
+                }
+            }
+
+            dst(Factor-1).sample = inBuf[i+2];
+            dst(Factor-1).derivative = dinBuf[i+2] * inputSampleRate;
+        }
+
+        return inUp;
+    }();
+
+    // Decimator input, behind the history of every branch
+    array<Frame*, Factor> poly;
+    for (size_t p = 0; p < Factor; ++p)
+        poly[p] = prev_poly[p].Block();
+
+    auto ClippingStage_DoOne = [&, CfOverH = Cf/h](const auto& clipper, const Frame& in, const Frame& din) -> Frame {
+#ifdef CLIP
+        const Frame Y = clippingStageHP(in);
+        const Frame C = fma(1./Rg, Y, fma(-CfOverH, in, fma(CfOverH, prevClippingStageOut, fma(Cf, din, 0.0))));
+
+        const Frame delta = clipper(C);
+
+        const Frame clippingStageOut = in + delta;
+        prevClippingStageOut = clippingStageOut;
+
+        return clippingStageOut;
+#else
+        return in;
+#endif
+    };
+
+    // Parameter values at the end of every sub-block
+    constexpr size_t MaxSubBlocks = Automated ? (Capacity + SubBlock - 1) / SubBlock : 1;
+    const size_t subBlocks = Automated ? (count + SubBlock - 1) / SubBlock : 1;
+    auto SubBlockLength = [&](const size_t sb) -> size_t { return min<size_t>(SubBlock, count - sb * SubBlock); };
+
+    [[maybe_unused]] array<ParameterValues, MaxSubBlocks> schedule;
+    [[maybe_unused]] const double startLevel = level;
+    if constexpr (Automated)
+        for (size_t sb = 0; sb < subBlocks; ++sb)
+            schedule[sb] = automation(SubBlockLength(sb));
+
+    // One loop for both: the clipping stage's and the tone circuit's recurrences overlap in the pipeline.
+    // (Two separate loops, i.e. separate trace zones, cost ~25% of the whole chain.)
+    Frame diodeVoltagePeak {};
+    auto RunClippingStageAndTone = [&](const auto& clipper, const size_t from, const size_t to)
+    {
+        TRM_TRACE_ZONE("TS808 clip + tone");
+        for (size_t i = from; i < to; ++i)
+        {
+            const Frame& in  = inUp[i].sample;
+            const Frame& din = inUp[i].derivative;
+            const Frame clipOut = ClippingStage_DoOne(clipper, in, din);
+            diodeVoltagePeak = Peak(diodeVoltagePeak, clipOut - in);
+#ifdef TONE
+            const Frame toneOut = toneCircuit(clipOut);
+#else
+            const Frame toneOut = clipOut;
+#endif
+            poly[i % Factor][i / Factor] = toneOut;
+        }
+    };
+
+    auto RunSubBlocks = [&](const auto& clipper)
+    {
+        if constexpr (Automated)
+        {
+            for (size_t sb = 0; sb < subBlocks; ++sb)
+            {
+                SetGain(schedule[sb].gain);
+                SetTone(schedule[sb].tone);
+                RunClippingStageAndTone(clipper, Factor * sb * SubBlock, Factor * (sb * SubBlock + SubBlockLength(sb)));
+            }
+        }
+        else
+        {
+            RunClippingStageAndTone(clipper, 0, Factor * count);
+        }
+    };
+
+    if (exactClipping)
+        RunSubBlocks(clipperSolver);
+    else
+        RunSubBlocks(clipperTables);
+    meters.diodeVoltagePeak = max(meters.diodeVoltagePeak, MaxLane(diodeVoltagePeak));
+
+    // Linear ramp from the level reached by the previous sub-block
+    auto LevelAt = [&](const size_t i) -> double
+    {
+        if constexpr (Automated)
+        {
+            const size_t sb = i / SubBlock;
+            const double from = sb == 0 ? startLevel : schedule[sb - 1].level;
+            return lerp(from, schedule[sb].level, static_cast<double>(i - sb * SubBlock + 1) / static_cast<double>(SubBlockLength(sb)));
+        }
+        else
+        {
+            return level;
+        }
+    };
+
+    if constexpr (Automated)
+        level = schedule[subBlocks - 1].level;
+
+    Frame outputPeak {};
+    auto copyToOutput = [&, nextSampleIdx = offset, i = size_t{0}] (const Frame& _val) mutable
+    {
+        const Frame scaled = (_val / FullScaleSampleVoltage) * 2. * LevelAt(i++);
+        outputPeak = Peak(outputPeak, scaled);
+        for (size_t c = 0; c < Channels; ++c)
+            if (output[c] != nullptr)
+                output[c][nextSampleIdx] = static_cast<Sample>(Lane(scaled, c));
+        ++nextSampleIdx;
+    };
+
+    // Decimate
+    // All the polyphase branches are summed in one multiply-add chain per output, several outputs at a time.
+    // The branches of the symmetric prototype filters are folded (mirror image pairs multiplied once).
+    TRM_TRACE_ZONE("TS808 decimate");
+    if constexpr (Factor == 1)
+    {
+        for (size_t i = 0; i < count; ++i)
+            copyToOutput(poly[0][i]);
+    }
+    else
+    {
+        array<Frame, Capacity> decimated;
+        auto Store = [out = reinterpret_cast<double*>(decimated.data())](const size_t m, const double y) { out[m] = y; };
+
+        // Output i is the window [i, i + DecimatorTaps) of every branch
+        if constexpr (Factor == 4)
+            Decimation::ApplyBlock<true, Decimation::D4x_Poly_1, Decimation::D4x_Poly_2, Decimation::D4x_Poly_3, Decimation::D4x_Poly_4>(
+                count, Store, prev_poly[0].Window(), prev_poly[1].Window(), prev_poly[2].Window(), prev_poly[3].Window());
+        else
+            Decimation::ApplyBlock<true, Decimation::D2x_Poly_1, Decimation::D2x_Poly_2>(count, Store, prev_poly[0].Window(), prev_poly[1].Window());
+
+        for (size_t i = 0; i < count; ++i)
+            copyToOutput(decimated[i]);
+    }
+
+    meters.outputPeak = max(meters.outputPeak, MaxLane(outputPeak));
+
+    prev_in.Advance(count);
+    prev_din.Advance(count);
+    for (size_t p = 0; p < Factor; ++p)
+        prev_poly[p].Advance(count);
+}
+
+} // namespace TRM
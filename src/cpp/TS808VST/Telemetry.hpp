@@ -0,0 +1,135 @@
+//------------------------------------------------------------------------
+// Copyright (C) 2025 Ték Róbert Máté <eppenpontaz@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+namespace TRM {
+
+//------------------------------------------------------------------------
+//  TelemetryRange
+//
+//  Plain value range of a read-only output parameter, shared by the
+//  processor (normalizing) and the controller (displaying).
+//------------------------------------------------------------------------
+struct TelemetryRange
+{
+    double min;
+    double max;
+
+    constexpr double Normalize (const double plain) const { return std::clamp((plain - min) / (max - min), 0.0, 1.0); }
+};
+
+//------------------------------------------------------------------------
+//  TS808Telemetry
+//
+//  Load and signal statistics of the audio thread, collected block by block.
+//  The load of a block is its processing time over its real-time budget
+//  (numSamples / sampleRate), 100% is the deadline. Every PublishInterval of
+//  audio a snapshot is due: the peak and the average load, and the signal
+//  peaks over the blocks since the previous snapshot.
+//  Fixed size state only, nothing allocates or locks.
+//------------------------------------------------------------------------
+class TS808Telemetry
+{
+public:
+    inline static constexpr double PublishInterval = 0.05; // s of audio
+
+    inline static constexpr TelemetryRange LoadRange         {0.0, 200.0}; // % of the real-time budget
+    inline static constexpr TelemetryRange PeakRange         {-60.0, 6.0}; // dBFS
+    inline static constexpr TelemetryRange DiodeVoltageRange {0.0, 1.0};   // V
+
+    // In the units of the ranges above
+    struct Snapshot
+    {
+        double peakLoad         = 0.0;
+        double averageLoad      = 0.0;
+        double inputPeak        = PeakRange.min;
+        double outputPeak       = PeakRange.min;
+        double diodeVoltagePeak = 0.0;
+    };
+
+    void Setup (const double _sampleRate)
+    {
+        sampleRate = _sampleRate;
+        samplesPerSnapshot = std::max<std::size_t>(1, static_cast<std::size_t>(PublishInterval * sampleRate));
+        Restart();
+    }
+
+    // 'meters' are the engine's signal meters over the block (TS808Engine::TakeMeters()).
+    // Returns true when a snapshot is due.
+    template <class Meters>
+    bool AddBlock (const std::size_t numSamples, const double processingSeconds, const Meters& meters)
+    {
+        const double budget = static_cast<double>(numSamples) / sampleRate;
+        peakLoad         = std::max(peakLoad, processingSeconds / budget);
+        totalSeconds    += processingSeconds;
+        totalBudget     += budget;
+        inputPeak        = std::max(inputPeak, meters.inputPeak);
+        outputPeak       = std::max(outputPeak, meters.outputPeak);
+        diodeVoltagePeak = std::max(diodeVoltagePeak, meters.diodeVoltagePeak);
+
+        samples += numSamples;
+        return samples >= samplesPerSnapshot;
+    }
+
+    // The statistics since the previous snapshot, starts the next window
+    Snapshot TakeSnapshot ()
+    {
+        const Snapshot result{ .peakLoad         = 100.0 * peakLoad,
+                               .averageLoad      = totalBudget > 0.0 ? 100.0 * totalSeconds / totalBudget : 0.0,
+                               .inputPeak        = ToDecibels(inputPeak),
+                               .outputPeak       = ToDecibels(outputPeak),
+                               .diodeVoltagePeak = diodeVoltagePeak };
+        Restart();
+        return result;
+    }
+
+private:
+    // Input and output samples are full scale at 1.0
+    static double ToDecibels (const double peak)
+    {
+        return peak > 0.0 ? std::max(20.0 * std::log10(peak), PeakRange.min) : PeakRange.min;
+    }
+
+    void Restart ()
+    {
+        samples          = 0;
+        peakLoad         = 0.0;
+        totalSeconds     = 0.0;
+        totalBudget      = 0.0;
+        inputPeak        = 0.0;
+        outputPeak       = 0.0;
+        diodeVoltagePeak = 0.0;
+    }
+
+    double sampleRate = 48'000.;
+    std::size_t samplesPerSnapshot = 2'400;
+
+    std::size_t samples     = 0;
+    double peakLoad         = 0.0;
+    double totalSeconds     = 0.0;
+    double totalBudget      = 0.0;
+    double inputPeak        = 0.0;
+    double outputPeak       = 0.0;
+    double diodeVoltagePeak = 0.0;
+};
+
+} // namespace TRM
@@ -19,7 +19,11 @@
 
 #include "IIR.hpp"
 
+#include <algorithm>
 #include <array>
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
 
 namespace TRM
 {
@@ -55,7 +59,37 @@ namespace TRM
         { 0.97329747275843070, 0.90078638748869400, 0.98030379788969091, -0.66532288702220455, 0.07494915386971208, 1.0 }
     }};
 
-    constexpr IIR_3_2 getIIRCoefficients(double param) {
+    using Tone_IIR_Table_Type = std::remove_const_t<decltype(Tone_IIR_Table)>;
+
+    // Sample rate the table was fitted at (see tone_circuit_iir_table_optimization.py)
+    inline constexpr double Tone_IIR_Table_SampleRate = 192'000.;
+
+    // Moves the poles and zeros of the table to another sample rate (matched Z-transform).
+    // The negative real zero has no analog counterpart, it is kept as is.
+    // The gain is corrected so that the DC response remains the same.
+    inline Tone_IIR_Table_Type ResampleToneTable(const double sampleRate)
+    {
+        const double ratio = Tone_IIR_Table_SampleRate / sampleRate;
+        auto Move = [ratio](const double r) { return r > 0.0 ? std::pow(r, ratio) : r; };
+
+        Tone_IIR_Table_Type result = Tone_IIR_Table;
+        for (IIR_Data& data : result)
+        {
+            const IIR_Data orig = data;
+            data.p1 = Move(orig.p1);
+            data.p2 = Move(orig.p2);
+            data.z1 = Move(orig.z1);
+            data.z2 = Move(orig.z2);
+
+            auto DCResponse = [](const IIR_Data& d) {
+                return ((1. - d.z1) * (1. - d.z2)) / ((1. - d.p1) * (1. - d.p2));
+            };
+            data.gain = orig.gain * DCResponse(orig) / DCResponse(data);
+        }
+        return result;
+    }
+
+    constexpr IIR_3_2 getIIRCoefficients(double param, const Tone_IIR_Table_Type& table = Tone_IIR_Table) {
         param = std::clamp(param, 0.0, 1.0);
 
         constexpr auto ToCoefficients = [](const IIR_Data& data) constexpr -> IIR_3_2
@@ -70,17 +104,17 @@ namespace TRM
         };
 
         if (param == 0.0) {
-            return ToCoefficients(Tone_IIR_Table[0]);
+            return ToCoefficients(table[0]);
         }
 
         if (param == 1.0) {
-            return ToCoefficients(Tone_IIR_Table.back());
+            return ToCoefficients(table.back());
         }
 
-        auto it = std::lower_bound(Tone_IIR_Table.begin(), Tone_IIR_Table.end(), param,
+        auto it = std::lower_bound(table.begin(), table.end(), param,
             [](const IIR_Data& data, double value) { return data.param < value; });
 
-        if (it == Tone_IIR_Table.begin()) ++it;
+        if (it == table.begin()) ++it;
 
         const auto& lo = *(it - 1);
         const auto& hi = *it;
@@ -95,4 +129,73 @@ namespace TRM
         return ToCoefficients({p1, p2, z1, z2, gain, param});
     }
 
+    //------------------------------------------------------------------------
+    //  ToneCoefficientTable
+    //
+    //  getIIRCoefficients() sampled on a uniform grid of the tone parameter, so
+    //  that a lookup is an index computation and a lerp between two ready-made
+    //  coefficient sets, instead of a search and a pole / zero -> coefficient
+    //  conversion.
+    //  The grid step is 0.001: every breakpoint of the table (all multiples of
+    //  0.02) is a grid point, so the poles and zeros are linear within every
+    //  cell and lerping the coefficients only misses the second order terms
+    //  of the products (p1 * p2, gain * z1, ...), ~1e-7 at this step.
+    //------------------------------------------------------------------------
+    class ToneCoefficientTable
+    {
+    public:
+        inline static constexpr std::size_t Steps = 1000;
+        inline static constexpr std::size_t Size  = Steps + 1;
+
+        constexpr ToneCoefficientTable() : ToneCoefficientTable(Tone_IIR_Table) {}
+
+        constexpr explicit ToneCoefficientTable(const Tone_IIR_Table_Type& table)
+        {
+            for (std::size_t k = 0; k < Size; ++k)
+                coefs[k] = getIIRCoefficients(static_cast<double>(k) / static_cast<double>(Steps), table);
+        }
+
+        constexpr IIR_3_2 operator()(const double param) const
+        {
+            const double pos = std::clamp(param, 0.0, 1.0) * static_cast<double>(Steps);
+            const std::size_t k = std::min(static_cast<std::size_t>(pos), Steps - 1);
+            const double t = pos - static_cast<double>(k);
+
+            const IIR_3_2& lo = coefs[k];
+            const IIR_3_2& hi = coefs[k + 1];
+            auto Lerp = [t](const double a, const double b) { return a + t * (b - a); };
+            return IIR_3_2{
+                .b0 = Lerp(lo.b0, hi.b0),
+                .b1 = Lerp(lo.b1, hi.b1),
+                .b2 = Lerp(lo.b2, hi.b2),
+                .a1 = Lerp(lo.a1, hi.a1),
+                .a2 = Lerp(lo.a2, hi.a2)
+            };
+        }
+
+        // Coefficients of the tone parameter k / Steps
+        constexpr const IIR_3_2& operator[](const std::size_t k) const { return coefs[k]; }
+
+        static constexpr std::size_t NearestGridPoint(const double param)
+        {
+            return static_cast<std::size_t>(std::clamp(param, 0.0, 1.0) * static_cast<double>(Steps) + 0.5);
+        }
+
+    private:
+        std::array<IIR_3_2, Size> coefs{};
+    };
+
+    inline constexpr ToneCoefficientTable Tone_IIR_CoefficientTable{};
+
+    // Every breakpoint must be a grid point, otherwise the kink there would be smoothed over.
+    // Looked up at a breakpoint, the table reproduces the fitted filter exactly.
+    static_assert(std::ranges::all_of(Tone_IIR_Table, [](const IIR_Data& data) {
+        const std::size_t k = ToneCoefficientTable::NearestGridPoint(data.param);
+        const IIR_3_2 fitted = getIIRCoefficients(data.param);
+        const IIR_3_2 looked = Tone_IIR_CoefficientTable(data.param);
+        return static_cast<double>(k) / static_cast<double>(ToneCoefficientTable::Steps) == data.param &&
+               looked.b0 == fitted.b0 && looked.b1 == fitted.b1 && looked.b2 == fitted.b2 &&
+               looked.a1 == fitted.a1 && looked.a2 == fitted.a2;
+    }));
+
 } // namespace TRM
@@ -18,6 +18,7 @@
 #include "controller.h"
 #include "cids.h"
 #include "pids.h"
+#include "Telemetry.hpp"
 #include "vstgui/plugin-bindings/vst3editor.h"
 #include "base/source/fstreamer.h"
 
@@ -41,6 +42,17 @@ parameters.addParameter (STR ("Gain"), STR ("%"), 0, 0., ParameterInfo::kCanAuto
 parameters.addParameter (STR ("Tone"), STR ("%"), 0, 0., ParameterInfo::kCanAutomate, ParameterID::Tone);
 parameters.addParameter (STR ("Level"), STR ("%"), 0, 0., ParameterInfo::kCanAutomate, ParameterID::Level);
 
+// Telemetry of the audio thread, updated by the processor through the output parameter changes
+auto AddReadOnly = [this] (const TChar* title, const ParamID id, const TChar* units, const TelemetryRange& range)
+{
+parameters.addParameter (new RangeParameter (title, id, units, range.min, range.max, range.min, 0, ParameterInfo::kIsReadOnly));
+};
+AddReadOnly (STR ("DSP Load"), ParameterID::AverageLoad, STR ("%"), TS808Telemetry::LoadRange);
+AddReadOnly (STR ("DSP Load Peak"), ParameterID::PeakLoad, STR ("%"), TS808Telemetry::LoadRange);
+AddReadOnly (STR ("Input Peak"), ParameterID::InputPeak, STR ("dB"), TS808Telemetry::PeakRange);
+AddReadOnly (STR ("Output Peak"), ParameterID::OutputPeak, STR ("dB"), TS808Telemetry::PeakRange);
+AddReadOnly (STR ("Diode Voltage"), ParameterID::DiodeVoltage, STR ("V"), TS808Telemetry::DiodeVoltageRange);
+
 return result;
 }
 
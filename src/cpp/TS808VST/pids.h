@@ -23,7 +23,14 @@ enum ParameterID
 {
     Gain = 1,
     Tone,
-    Level
+    Level,
+
+    // Read-only, published by the processor (see TS808Telemetry)
+    AverageLoad = 100,
+    PeakLoad,
+    InputPeak,
+    OutputPeak,
+    DiodeVoltage
 };
 
 } // TRM
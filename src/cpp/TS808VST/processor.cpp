@@ -21,6 +21,7 @@
 #include "base/source/fstreamer.h"
 #include "pluginterfaces/vst/ivstparameterchanges.h"
 
+#include <chrono>
 #include <fstream>
 
 using namespace Steinberg;
@@ -71,6 +72,8 @@ tresult PLUGIN_API TS808ClipperProcessor::setActive (TBool state)
 //------------------------------------------------------------------------
 tresult PLUGIN_API TS808ClipperProcessor::process (Vst::ProcessData& data)
 {
+    const auto start = std::chrono::steady_clock::now ();
+
     stateTransfer.accessTransferObject_rt ([this] (const auto& stateModel)
     {
         gainParameter.setValue (stateModel.gain);
@@ -96,12 +99,19 @@ tresult PLUGIN_API TS808ClipperProcessor::process (Vst::ProcessData& data)
     gainParameter.endChanges ();
     toneParameter.endChanges ();
     levelParameter.endChanges ();
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now () - start;
+    if (telemetry.AddBlock (static_cast<size_t> (data.numSamples), elapsed.count (), engine.TakeMeters ()))
+        publishTelemetry (data.outputParameterChanges);
     return kResultOk;
 }
 
 //------------------------------------------------------------------------
 tresult PLUGIN_API TS808ClipperProcessor::setupProcessing (Vst::ProcessSetup& newSetup)
 {
+    // Picks the oversampling factor and generates the sample rate dependent coefficients
+    engine.Setup (newSetup.sampleRate);
+    telemetry.Setup (newSetup.sampleRate);
     return AudioEffect::setupProcessing (newSetup);
 }
 
@@ -186,5 +196,25 @@ void TS808ClipperProcessor::handleParameterChanges (IParameterChanges* changes)
     }
 }
 
+//------------------------------------------------------------------------
+void TS808ClipperProcessor::publishTelemetry (IParameterChanges* outputChanges)
+{
+    const TS808Telemetry::Snapshot snapshot = telemetry.TakeSnapshot ();
+    if (!outputChanges)
+        return;
+
+    auto Publish = [outputChanges] (const ParamID id, const ParamValue normalized)
+    {
+        int32 index = 0;
+        if (auto queue = outputChanges->addParameterData (id, index))
+            queue->addPoint (0, normalized, index);
+    };
+    Publish (ParameterID::AverageLoad,  TS808Telemetry::LoadRange.Normalize (snapshot.averageLoad));
+    Publish (ParameterID::PeakLoad,     TS808Telemetry::LoadRange.Normalize (snapshot.peakLoad));
+    Publish (ParameterID::InputPeak,    TS808Telemetry::PeakRange.Normalize (snapshot.inputPeak));
+    Publish (ParameterID::OutputPeak,   TS808Telemetry::PeakRange.Normalize (snapshot.outputPeak));
+    Publish (ParameterID::DiodeVoltage, TS808Telemetry::DiodeVoltageRange.Normalize (snapshot.diodeVoltagePeak));
+}
+
 //------------------------------------------------------------------------
 } // namespace TRM
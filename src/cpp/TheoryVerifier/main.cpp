@@ -20,47 +20,45 @@
 #include "FiniteDifferenceMethod.hpp"
 #include "TS808Components.hpp"
 #include "Utility.hpp"
+#include "WavStream.hpp"
 
+#include <algorithm>
 #include <fstream>
-#include <functional>
-#include <ranges>
+#include <iomanip>
 
 using namespace std;
 using namespace TRM;
 
 constexpr int ExpectedSampleRate = 48'000;
 
-int main ()
+int main (const int argc, const char* const* argv)
 {
+    AnswerPromptsFrom(argc, argv);
+
     const auto CorrectInputFile = AllOf | SampleRate(ExpectedSampleRate) | NonEmpty;
 
-    auto vOP_P_d_wav = Prompt<ExistingAudioFile> ("Path to V(OP_P_d) (48 kHz): ", CorrectInputFile);
-    vOP_P_d_wav.printSummary();
+    const auto vOP_P_d_wav = Prompt<ExistingWavFile> ("Path to V(OP_P_d) (48 kHz): ", CorrectInputFile);
+    vOP_P_d_wav.PrintSummary();
 
-    auto vOP_N_d_wav = Prompt<ExistingAudioFile> ("Path to V(OP_N_d): ", CorrectInputFile);
-    vOP_N_d_wav.printSummary();
+    const auto vOP_N_d_wav = Prompt<ExistingWavFile> ("Path to V(OP_N_d): ", CorrectInputFile);
+    vOP_N_d_wav.PrintSummary();
 
-    auto vOP_OUT_d_wav = Prompt<ExistingAudioFile> ("Path to V(OP_OUT_d): ", CorrectInputFile);
-    vOP_OUT_d_wav.printSummary();
+    const auto vOP_OUT_d_wav = Prompt<ExistingWavFile> ("Path to V(OP_OUT_d): ", CorrectInputFile);
+    vOP_OUT_d_wav.PrintSummary();
 
-    auto vY_d_wav = Prompt<ExistingAudioFile> ("Path to V(Y_d): ", CorrectInputFile);
-    vY_d_wav.printSummary();
+    const auto vY_d_wav = Prompt<ExistingWavFile> ("Path to V(Y_d): ", CorrectInputFile);
+    vY_d_wav.PrintSummary();
 
     // Hack: LTspice can only output integer wav, which would be clipped where the values
     // are outside of [-1, 1] --> output 0.1 * value --> need to compensate here
-    auto ScaleBy = [](const double s, vector<double>& v)
+    struct ScaledInput
     {
-        for (double& d : v) d *= s;
+        WavReader reader;
+        double Next() { return 10. * reader.NextFrame()[0]; }
     };
-    ScaleBy(10., vOP_P_d_wav.samples[0]);
-    ScaleBy(10., vOP_N_d_wav.samples[0]);
-    ScaleBy(10., vOP_OUT_d_wav.samples[0]);
-    ScaleBy(10., vY_d_wav.samples[0]);
-
-    const vector<double>& OP_P = vOP_P_d_wav.samples[0];
-    const vector<double>& OP_N = vOP_N_d_wav.samples[0];
-    const vector<double>& OP_OUT = vOP_OUT_d_wav.samples[0];
-    const vector<double>& Y = vY_d_wav.samples[0];
+    // V(OP_N_d) doesn't take part in the calculation, only in the length
+    ScaledInput OP_P{WavReader{vOP_P_d_wav.path}}, OP_OUT{WavReader{vOP_OUT_d_wav.path}}, Y{WavReader{vY_d_wav.path}};
+    const auto length = min({vOP_P_d_wav.Format().frames, vOP_N_d_wav.Format().frames, vOP_OUT_d_wav.Format().frames, vY_d_wav.Format().frames});
 
     ofstream out{"verified.txt"};
     out << "I(Rg)\tI(Feedback Loop)\n";
@@ -71,23 +69,28 @@ int main ()
         out << 0.0 << '\t' << 0.0 << '\n';
     }
 
-    auto zippedView = views::zip(
-        OP_P | views::adjacent<7>,
-        OP_N | views::adjacent<7>,
-        OP_OUT | views::adjacent<7>,
-        views::transform(Y, [](double d){ return d - OpAmpBias; }) | views::adjacent<7>,
-        views::zip_transform(minus{}, OP_OUT, OP_P) | views::adjacent<7>
-    );
+    // Sliding windows of 7 samples, like views::adjacent<7>
+    CircleBuffer<double, 7> y, delta;
+    auto Load = [&]
+    {
+        const double op_p = OP_P.Next();
+        y.RotateLeft()     = Y.Next() - OpAmpBias;
+        delta.RotateLeft() = OP_OUT.Next() - op_p;
+    };
+    for (int i = 0; i < 6; ++i)
+        Load();
 
     FiniteDiff<1. / ExpectedSampleRate> diff;
 
-    for (const auto [op_p, op_n, op_out, y, delta] : zippedView)
+    for (auto i = length - 6; i-->0;)
     {
+        Load();
+
         // Current through ground resistor
-        out << get<3>(y)/Rg << '\t';
+        out << y.Get<3>()/Rg << '\t';
 
         // Current through feedback components
-        const double d = get<3>(delta);
+        const double d = delta.Get<3>();
         out << (diff.FirstDerivative(delta) * Cf + d/Rf + Diode_1N4148_Current(d) - Diode_1N4148_Current(-d)) << '\n';
     }
 }
@@ -17,16 +17,42 @@
 
 #pragma once
 
-#include "AudioFile/AudioFile.h"
+#include "MappedWav.hpp"
 #include "Prompt.hpp"
+#include "WavStream.hpp"
 
 #include <filesystem>
+#include <format>
+#include <iostream>
 #include <string>
 
 namespace TRM
 {
 
-    struct ExistingAudioFile : AudioFile<double> { using AudioFile<double>::AudioFile; };
+    // The file is mapped at the prompt, which only reads the header. Tools that need all of it at once
+    // decode it with DecodeChannels() (in parallel), the others stream it with a WavReader on 'path'.
+    struct ExistingWavFile : MappedWavFile
+    {
+        ExistingWavFile() = default;
+        ExistingWavFile(const std::string& path)
+            : MappedWavFile{std::filesystem::path{path}}
+            , path{path}
+        {}
+
+        void PrintSummary() const
+        {
+            const WavFormat& format = Format();
+            std::cout << "|======================================|\n"
+                      << std::format("Num Channels: {}\n", format.channels)
+                      << std::format("Num Samples Per Channel: {}\n", format.frames)
+                      << std::format("Sample Rate: {}\n", format.sampleRate)
+                      << std::format("Bit Depth: {}{}\n", format.bitDepth, format.sampleType == WavSampleType::Float ? " (float)" : "")
+                      << std::format("Length in Seconds: {}\n", static_cast<double>(format.frames) / format.sampleRate)
+                      << "|======================================|\n";
+        }
+
+        std::filesystem::path path;
+    };
 
     PROMPT_PART(ExistingWavPath, std::string, "Enter file path (.wav, must exist): ", [](const std::string& s){
         const std::filesystem::path p {s};
@@ -34,15 +60,15 @@ namespace TRM
     });
 
     // Common prompt predicates
-    constexpr auto NonEmpty = [](const ExistingAudioFile& file) -> bool { return file.samples[0].size() >  10u; };
-    constexpr auto Stereo   = [](const ExistingAudioFile& file) -> bool { return file.samples.size()    >= 2u ; };
+    constexpr auto NonEmpty = [](const ExistingWavFile& file) -> bool { return file.Format().frames   >  10u; };
+    constexpr auto Stereo   = [](const ExistingWavFile& file) -> bool { return file.Format().channels >= 2u ; };
 
     constexpr auto SampleRate(const auto expected)
     {
         auto e = static_cast<std::uint32_t>(expected);
-        return [e](const ExistingAudioFile& file){ return file.getSampleRate() == e; };
+        return [e](const ExistingWavFile& file){ return file.Format().sampleRate == e; };
     }
 
 } // namespace TRM
 
-PROMPT_PREFERENCES(TRM::ExistingAudioFile, TRM::ExistingWavPath);
+PROMPT_PREFERENCES(TRM::ExistingWavFile, TRM::ExistingWavPath);
@@ -0,0 +1,335 @@
+/*
+ * Copyright (C) 2025 Ték Róbert Máté <eppenpontaz@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Prompt.hpp"
+#include "Stopwatch.hpp"
+#include "Tracer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <span>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace TRM
+{
+
+    // Runs f(0) ... f(count-1) on 'threads' worker threads, in no particular order
+    inline void ParallelFor(const std::size_t count, const std::size_t threads, auto&& f)
+    {
+        std::atomic<std::size_t> next = 0;
+        auto Worker = [&]
+        {
+            for (std::size_t i = next++; i < count; i = next++)
+                f(i);
+        };
+
+        std::vector<std::jthread> workers;
+        for (std::size_t t = 1; t < std::min(threads, count); ++t)
+            workers.emplace_back(Worker);
+        Worker();
+    }
+
+    struct ChunkedRenderSettings
+    {
+        std::size_t chunkSize = 0; // Samples per chunk, 0: the whole signal in one chunk
+        std::size_t preRoll   = 0; // Samples processed (and thrown away) before each chunk to warm up its state
+        std::size_t threads   = std::max(1u, std::thread::hardware_concurrency());
+    };
+
+    // Splits [first, first + length) into chunks and renders them in parallel.
+    //
+    // Every chunk gets a freshly created processor from makeProcessor(). It is first run over the
+    // 'preRoll' samples preceding the chunk with warmUp == true (the output must be discarded),
+    // then over the chunk itself:  processor(begin, end, warmUp)  processes samples [begin, end).
+    // Chunk i therefore starts from the state a serial run would have, minus whatever the state
+    // remembers from before the pre-roll. Indexing the input and output is up to the processor.
+    // Streamed signals are rendered window by window, with 'first' a multiple of the chunk size
+    // the chunks are the same as when rendering everything at once.
+    inline void RenderInChunks(const std::size_t first, const std::size_t length, const ChunkedRenderSettings& settings, auto&& makeProcessor)
+    {
+        const std::size_t chunkSize = settings.chunkSize == 0 ? length : settings.chunkSize;
+        const std::size_t chunks    = chunkSize == 0 ? 0 : (length + chunkSize - 1) / chunkSize;
+
+        ParallelFor(chunks, settings.threads, [&](const std::size_t i)
+        {
+            const std::size_t begin = first + i * chunkSize;
+            const std::size_t end   = std::min(begin + chunkSize, first + length);
+
+            auto processor = makeProcessor();
+            const std::size_t warmUpBegin = begin - std::min(begin, settings.preRoll);
+            if (warmUpBegin < begin)
+            {
+                TRM_TRACE_ZONE("chunk pre-roll");
+                processor(warmUpBegin, begin, true);
+            }
+            TRM_TRACE_ZONE("chunk");
+            processor(begin, end, false);
+        });
+    }
+
+    inline void RenderInChunks(const std::size_t length, const ChunkedRenderSettings& settings, auto&& makeProcessor)
+    {
+        RenderInChunks(0, length, settings, makeProcessor);
+    }
+
+    struct SeamError
+    {
+        double maxAbs     = 0.0; // Largest difference to the serial rendering, over the finite samples
+        std::size_t where = 0;   // ... and its sample index
+        std::size_t exactSeams = 0;
+        std::size_t seams      = 0;
+        std::size_t nonFinite  = 0; // Samples that are NaN or infinite in either rendering
+
+        // Accumulates the errors of consecutive windows
+        void Merge(const SeamError& other)
+        {
+            if (other.maxAbs > maxAbs)
+            {
+                maxAbs = other.maxAbs;
+                where  = other.where;
+            }
+            exactSeams += other.exactSeams;
+            seams      += other.seams;
+            nonFinite  += other.nonFinite;
+        }
+    };
+
+    // Compares a chunked rendering with the serial one. A seam is exact if the whole chunk after it
+    // matches the serial rendering bit for bit and is finite: two renderings that both diverged are
+    // counted in 'nonFinite', not as a match. The signals start at sample 'first' (a multiple of
+    // the chunk size) when they are a window of a longer one.
+    inline SeamError MeasureSeamError(std::span<const double> chunked, std::span<const double> serial, const std::size_t chunkSize,
+                                      const std::size_t first = 0)
+    {
+        // NaN or infinite. Tested on the bits, under -ffast-math std::isfinite may be assumed to be true.
+        constexpr std::uint64_t ExponentMask = 0x7ff0'0000'0000'0000;
+        auto NonFinite = [](const std::uint64_t bits) { return (bits & ExponentMask) == ExponentMask; };
+
+        SeamError result;
+        const std::size_t length = std::min(chunked.size(), serial.size());
+        for (std::size_t begin = 0; begin < length; begin += (chunkSize == 0 ? length : chunkSize))
+        {
+            const std::size_t end = chunkSize == 0 ? length : std::min(begin + chunkSize, length);
+            bool exact = true;
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                const std::uint64_t a = std::bit_cast<std::uint64_t>(chunked[i]);
+                const std::uint64_t b = std::bit_cast<std::uint64_t>(serial[i]);
+                if (NonFinite(a) || NonFinite(b))
+                {
+                    exact = false;
+                    ++result.nonFinite;
+                    continue;
+                }
+                if (a == b)
+                    continue;
+
+                exact = false;
+                const double diff = std::abs(chunked[i] - serial[i]);
+                if (diff > result.maxAbs)
+                {
+                    result.maxAbs = diff;
+                    result.where  = first + i;
+                }
+            }
+            if (first + begin > 0)
+            {
+                ++result.seams;
+                result.exactSeams += exact ? 1 : 0;
+            }
+        }
+        return result;
+    }
+
+    // The input of a windowed rendering, read from a stream as the window slides along it:
+    // window[i] is sample i, for i in [Begin(), End())
+    template<class T>
+    class SlidingWindow
+    {
+    public:
+        // Reads with next() until 'end', and drops the samples before 'begin' (begin <= end, both only grow)
+        void Slide(const std::size_t begin, const std::size_t end, auto&& next)
+        {
+            while (End() < end)
+                samples.push_back(next());
+            samples.erase(samples.begin(), samples.begin() + static_cast<std::ptrdiff_t>(begin - base));
+            base = begin;
+        }
+
+        const T& operator[](const std::size_t i) const { return samples[i - base]; }
+
+        std::size_t Begin() const { return base; }
+        std::size_t End() const { return base + samples.size(); }
+
+    private:
+        std::vector<T> samples;
+        std::size_t base = 0;
+    };
+
+    // One T per channel, Channels == std::dynamic_extent when the number of channels is only known at run time
+    template<class T, std::size_t Channels>
+    using PerChannel = std::conditional_t<Channels == std::dynamic_extent, std::vector<T>, std::array<T, Channels>>;
+
+    namespace _Impl
+    {
+        template<class T, std::size_t Channels>
+        PerChannel<T, Channels> MakePerChannel(const std::size_t channels)
+        {
+            if constexpr (Channels == std::dynamic_extent)
+                return std::vector<T>(channels);
+            else
+                return {};
+        }
+    }
+
+    // The output of one window, channel by channel
+    template<std::size_t Channels>
+    using WindowBuffers = PerChannel<std::vector<double>, Channels>;
+
+    template<std::size_t Channels>
+    struct WindowedRenderResult
+    {
+        ChunkedRenderSettings settings;
+        bool verify = false;
+        PerChannel<SeamError, Channels> errors; // Only measured with 'verify'
+        CumulativeStopwatch chunkedTime, serialTime;
+
+        // The timings, and the seam errors of every channel. 'firstSample' is the index in the output
+        // file of the first rendered sample.
+        void Print(const std::string_view name, const double sampleRate, const std::size_t firstSample = 0) const
+        {
+            if (settings.chunkSize == 0)
+            {
+                serialTime.Print(std::format("Serial {}:", name));
+                return;
+            }
+
+            chunkedTime.Print(std::format("Parallel {} ({} threads):", name, settings.threads));
+            if (!verify)
+                return;
+
+            serialTime.Print(std::format("Serial {} (reference):", name));
+            for (std::size_t c = 0; c < errors.size(); ++c)
+            {
+                const SeamError& error = errors[c];
+                std::cout << std::format(" └ {}{} of {} seam(s) bit-exact, max error {:.3e} at {:.3f} s, {} non-finite sample(s)\n",
+                                         errors.size() > 1 ? std::format("channel {}: ", c) : "", error.exactSeams, error.seams, error.maxAbs,
+                                         static_cast<double>(firstSample + error.where) / sampleRate, error.nonFinite);
+            }
+        }
+    };
+
+    // Renders 'length' samples of 'Channels' outputs window by window, for files too long to keep in memory.
+    // With chunking (settings.chunkSize > 0) a window is a whole number of chunks per thread, rendered with
+    // RenderInChunks(), so the chunks are the same as if everything was rendered in one go. Otherwise a
+    // single processor renders the windows one after the other.
+    //   slide(begin, end)             the input of the samples [begin, end) is needed next, the pre-roll included
+    //   makeProcessor(dst, dstBegin)  a processor (see RenderInChunks) that writes sample k of channel c to dst[c][k - dstBegin]
+    //   write(rendered)               takes the rendered window, a span per channel
+    // With 'verify' the chunked rendering is compared with a serial one at the seams.
+    // 'channels' is the number of channels, needed when it is only known at run time (Channels == std::dynamic_extent).
+    template<std::size_t Channels>
+    WindowedRenderResult<Channels> RenderInWindows(const std::size_t channels, const std::size_t length, const ChunkedRenderSettings& settings,
+                                                   const bool verify, auto&& slide, auto&& makeProcessor, auto&& write)
+    {
+        const bool chunked = settings.chunkSize > 0;
+        const std::size_t windowSize = chunked ? settings.chunkSize * settings.threads : std::size_t{1} << 16;
+
+        WindowedRenderResult<Channels> result;
+        result.settings = settings;
+        result.verify   = chunked && verify;
+        result.errors   = _Impl::MakePerChannel<SeamError, Channels>(channels);
+
+        std::size_t windowBegin = 0;
+        auto output       = _Impl::MakePerChannel<std::vector<double>, Channels>(channels);
+        auto serialOutput = _Impl::MakePerChannel<std::vector<double>, Channels>(channels);
+        for (std::size_t c = 0; c < channels; ++c)
+        {
+            output[c].resize(chunked ? windowSize : 0);
+            serialOutput[c].resize(!chunked || verify ? windowSize : 0);
+        }
+        auto serial = makeProcessor(serialOutput, windowBegin); // Carries its state over to the next window
+
+        for (; windowBegin < length; windowBegin += windowSize)
+        {
+            const std::size_t windowEnd = std::min(windowBegin + windowSize, length);
+            slide(windowBegin - std::min(windowBegin, chunked ? settings.preRoll : 0), windowEnd);
+
+            const WindowBuffers<Channels>& rendered = chunked ? output : serialOutput;
+            if (chunked)
+                result.chunkedTime.Measure([&]{ RenderInChunks(windowBegin, windowEnd - windowBegin, settings, [&]{ return makeProcessor(output, windowBegin); }); });
+            if (!chunked || verify)
+                result.serialTime.Measure([&]{ serial(windowBegin, windowEnd, false); });
+
+            auto window = _Impl::MakePerChannel<std::span<const double>, Channels>(channels);
+            for (std::size_t c = 0; c < channels; ++c)
+            {
+                window[c] = std::span{rendered[c]}.first(windowEnd - windowBegin);
+                if (chunked && verify)
+                    result.errors[c].Merge(MeasureSeamError(window[c], std::span{serialOutput[c]}.first(window[c].size()), settings.chunkSize, windowBegin));
+            }
+            write(window);
+        }
+        return result;
+    }
+
+    template<std::size_t Channels = 1>
+    WindowedRenderResult<Channels> RenderInWindows(const std::size_t length, const ChunkedRenderSettings& settings, const bool verify,
+                                                   auto&& slide, auto&& makeProcessor, auto&& write)
+    {
+        return RenderInWindows<Channels>(Channels, length, settings, verify, slide, makeProcessor, write);
+    }
+
+    // The command line of a tool rendering in chunks: --verify (anywhere) measures the seam error against a serial
+    // rendering, the other arguments answer the prompts (see AnswerPromptsFrom). Returns whether --verify was given.
+    inline bool AnswerPromptsAndTakeVerify(const int argc, const char* const* argv)
+    {
+        std::vector<const char*> args(argv, argv + argc);
+        const auto verifyArg = std::find_if(args.begin() + (argc > 0 ? 1 : 0), args.end(), [](const char* arg){ return std::string_view{arg} == "--verify"; });
+        const bool verify = verifyArg != args.end();
+        if (verify)
+            args.erase(verifyArg);
+        AnswerPromptsFrom(static_cast<int>(args.size()), args.data());
+        return verify;
+    }
+
+    // Asks for the chunk length, and the pre-roll unless the rendering is serial
+    inline ChunkedRenderSettings PromptChunkedRenderSettings(const double sampleRate)
+    {
+        const double chunkSeconds = Prompt<double>("Chunk length in seconds for parallel processing (0 = serial): ",
+                                                   [](const double d){ return d >= 0.0; });
+        if (chunkSeconds == 0.0)
+            return ChunkedRenderSettings{ .chunkSize = 0, .preRoll = 0, .threads = 1 };
+
+        const double preRollMs = Prompt<double>("Pre-roll of every chunk in ms: ", [](const double d){ return d >= 0.0; });
+        return ChunkedRenderSettings{ .chunkSize = std::max<std::size_t>(1, static_cast<std::size_t>(chunkSeconds * sampleRate)),
+                                      .preRoll   = static_cast<std::size_t>(preRollMs * 1e-3 * sampleRate) };
+    }
+
+} // namespace TRM
@@ -17,35 +17,35 @@
 
 #pragma once
 
-#include <array>
+#include "MirroredRing.hpp"
 
 namespace TRM
 {
-    // Primitive circle buffer class.
+    // Circle buffer of the last Sz values, oldest first.
     // Can be used as a stencil, thanks to the std::get specialization.
-    // Not very performant though, so only used for prototyping.
+    // The values are kept contiguous in a MirroredRing, so Get<I>() is a plain index.
     template<class T, std::size_t Sz>
     class CircleBuffer
     {
     public:
         constexpr CircleBuffer() = default;
 
+        // The oldest value becomes the newest one (the caller usually overwrites it)
         T& RotateLeft ()
         {
-            const auto idxLastItemAfterRotate = idxBegin;
-            idxBegin = (idxBegin + 1u) % Sz;
-            return buf[idxLastItemAfterRotate];
+            ring.Block()[0] = ring.Window()[0];
+            ring.Advance(1);
+            return ring.Window()[Sz - 1];
         }
 
         template<std::size_t I> requires (I < Sz)
-        T& Get() { return buf[(idxBegin + I) % Sz]; }
+        T& Get() { return ring.Window()[I]; }
 
         template<std::size_t I> requires (I < Sz)
-        const T& Get() const { return buf[(idxBegin + I) % Sz]; }
+        const T& Get() const { return ring.Window()[I]; }
 
     private:
-        std::array<T, Sz> buf {};
-        std::size_t idxBegin = 0u;
+        MirroredRing<T, Sz, 1, 16 * Sz> ring;
     };
 
 
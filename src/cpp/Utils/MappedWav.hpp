@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2025 Ték Róbert Máté <eppenpontaz@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "ChunkedRender.hpp"
+#include "WavStream.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32)
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace TRM
+{
+
+    // A WAV file mapped into memory. Nothing is read up front: the header is parsed from the mapping
+    // and the pages of the samples are only loaded when they are decoded. 32 bit float files can be
+    // used in place, everything else is converted to double by the SIMD kernels of PcmConvert.hpp.
+    class MappedWavFile
+    {
+    public:
+        MappedWavFile() = default;
+
+        explicit MappedWavFile(const std::filesystem::path& path)
+        {
+            if (!Map(path))
+                return;
+
+            const auto layout = _Impl::ParseWavLayout(mapped.size(), [&](const std::uint64_t offset, std::byte* dst, const std::size_t n)
+            {
+                if (offset > mapped.size() || n > mapped.size() - offset)
+                    return false;
+                std::memcpy(dst, mapped.data() + offset, n);
+                return true;
+            });
+            if (!layout)
+            {
+                Unmap();
+                return;
+            }
+            format = layout->format;
+            samples = mapped.subspan(static_cast<std::size_t>(layout->dataOffset), static_cast<std::size_t>(format.frames * format.BytesPerFrame()));
+        }
+
+        MappedWavFile(MappedWavFile&& other) noexcept
+            : mapped {std::exchange(other.mapped, {})}
+            , samples{std::exchange(other.samples, {})}
+            , format {other.format}
+        {}
+
+        MappedWavFile& operator=(MappedWavFile&& other) noexcept
+        {
+            if (this != &other)
+            {
+                Unmap();
+                mapped  = std::exchange(other.mapped, {});
+                samples = std::exchange(other.samples, {});
+                format  = other.format;
+            }
+            return *this;
+        }
+
+        ~MappedWavFile() { Unmap(); }
+
+        explicit operator bool() const { return mapped.data() != nullptr; }
+
+        const WavFormat& Format() const { return format; }
+
+        // The interleaved samples as stored in the file
+        std::span<const std::byte> Bytes() const { return samples; }
+
+        // The interleaved samples of a 32 bit float file without any copy, empty for other formats
+        std::span<const float> Floats() const
+        {
+            const bool inPlace = format.sampleType == WavSampleType::Float && format.bitDepth == 32
+                              && std::endian::native == std::endian::little
+                              && reinterpret_cast<std::uintptr_t>(samples.data()) % alignof(float) == 0;
+            if (!inPlace)
+                return {};
+            return {reinterpret_cast<const float*>(samples.data()), samples.size() / sizeof(float)};
+        }
+
+        // Frames [firstFrame, firstFrame + dst.size() / channels) as interleaved doubles
+        void Decode(const std::uint64_t firstFrame, std::span<double> dst) const
+        {
+            const auto offset = static_cast<std::size_t>(firstFrame * format.BytesPerFrame());
+            _Impl::DecodeSamples(format, samples.data() + offset, dst);
+        }
+
+        // Every channel in a vector of its own, like AudioFile::samples.
+        // The file is converted in blocks, spread over 'threads' threads.
+        std::vector<std::vector<double>> DecodeChannels(const std::size_t threads = std::max(1u, std::thread::hardware_concurrency())) const
+        {
+            constexpr std::size_t BlockFrames = 1u << 16;
+
+            const auto frames = static_cast<std::size_t>(format.frames);
+            std::vector<std::vector<double>> channels(format.channels, std::vector<double>(frames));
+            ParallelFor((frames + BlockFrames - 1) / BlockFrames, threads, [&](const std::size_t block)
+            {
+                const std::size_t first = block * BlockFrames;
+                const std::size_t n     = std::min(BlockFrames, frames - first);
+                if (channels.size() == 1)
+                {
+                    Decode(first, std::span{channels[0]}.subspan(first, n));
+                    return;
+                }
+
+                std::vector<double> interleaved(n * channels.size());
+                Decode(first, interleaved);
+                const std::size_t stride = channels.size();
+                for (std::size_t c = 0; c < stride; ++c)
+                {
+                    double* const       out = channels[c].data() + first;
+                    const double* const in  = interleaved.data() + c;
+                    for (std::size_t i = 0; i < n; ++i)
+                        out[i] = in[i * stride];
+                }
+            });
+            return channels;
+        }
+
+    private:
+        bool Map(const std::filesystem::path& path)
+        {
+#if defined(_WIN32)
+            const HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (file == INVALID_HANDLE_VALUE)
+                return false;
+            LARGE_INTEGER size{};
+            const HANDLE mapping = GetFileSizeEx(file, &size) && size.QuadPart > 0
+                                 ? CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+            void* view = mapping != nullptr ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+            if (mapping != nullptr)
+                CloseHandle(mapping);
+            CloseHandle(file);
+            if (view == nullptr)
+                return false;
+            mapped = {static_cast<const std::byte*>(view), static_cast<std::size_t>(size.QuadPart)};
+#else
+            const int fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                return false;
+            struct stat st{};
+            void* view = fstat(fd, &st) == 0 && st.st_size > 0
+                       ? mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+            close(fd);
+            if (view == MAP_FAILED)
+                return false;
+            madvise(view, static_cast<std::size_t>(st.st_size), MADV_SEQUENTIAL);
+            mapped = {static_cast<const std::byte*>(view), static_cast<std::size_t>(st.st_size)};
+#endif
+            return true;
+        }
+
+        void Unmap()
+        {
+            if (mapped.data() == nullptr)
+                return;
+#if defined(_WIN32)
+            UnmapViewOfFile(mapped.data());
+#else
+            munmap(const_cast<std::byte*>(mapped.data()), mapped.size());
+#endif
+            mapped  = {};
+            samples = {};
+        }
+
+        std::span<const std::byte> mapped;  // The whole file
+        std::span<const std::byte> samples; // ... and the sample data in it
+        WavFormat format{ .sampleRate = 0, .channels = 0 };
+    };
+
+} // namespace TRM
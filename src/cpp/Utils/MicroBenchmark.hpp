@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2025 Ték Róbert Máté <eppenpontaz@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "PerfCounters.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <format>
+#include <functional>
+#include <numeric>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace TRM
+{
+
+    // Keeps the compiler from optimizing away the computation of 'value'
+    template<class T>
+    inline void DoNotOptimize(const T& value)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : "r,m"(value) : "memory");
+#else
+        const volatile auto* sink = &value;
+        (void)sink;
+#endif
+    }
+
+    struct BenchmarkStats
+    {
+        std::string name;
+        std::size_t samplesPerRun = 0;
+        std::size_t repetitions   = 0;
+
+        // Wall time of one run, nanoseconds
+        double minNs    = 0.0;
+        double medianNs = 0.0;
+        double meanNs   = 0.0;
+        double p99Ns    = 0.0;
+
+        // Hardware events per sample, over all the timed runs
+        PerfCounterValues perSample;
+
+        double NsPerSample() const { return medianNs / static_cast<double>(samplesPerRun); }
+    };
+
+    struct MicroBenchmarkSettings
+    {
+        std::size_t warmUpRuns  = 5;
+        std::size_t repetitions = 101;
+        std::string filter; // only the benchmarks whose name contains it are run
+        bool hardwareCounters = true; // see PerfCounters
+    };
+
+    //------------------------------------------------------------------------
+    //  MicroBenchmarkSuite
+    //
+    //  Every benchmark is a callable that processes 'samplesPerRun' samples of a
+    //  synthetic input. It is called warmUpRuns times untimed (caches, branch
+    //  predictors, lazily built tables), then timed 'repetitions' times. The
+    //  median is the headline number, p99 shows how bad the outliers get.
+    //  Where available, hardware counters are read over all the timed runs and
+    //  reported per sample.
+    //------------------------------------------------------------------------
+    class MicroBenchmarkSuite
+    {
+        using clock = std::chrono::steady_clock;
+    public:
+        explicit MicroBenchmarkSuite(MicroBenchmarkSettings settings) : settings{std::move(settings)} {}
+
+        void Add(std::string name, const std::size_t samplesPerRun, std::function<void()> run)
+        {
+            if (name.find(settings.filter) != std::string::npos)
+                benchmarks.push_back(Benchmark{ std::move(name), samplesPerRun, std::move(run) });
+        }
+
+        // Runs every benchmark, one summary line each is printed to 'log'
+        void Run(std::ostream& log)
+        {
+            using namespace std;
+
+            optional<PerfCounters> counters;
+            if (settings.hardwareCounters)
+            {
+                counters.emplace();
+                if (!counters->Available())
+                {
+                    log << " ! Hardware performance counters are not available, only timing !\n";
+                    counters.reset();
+                }
+            }
+
+            log << format("{:<52} {:>12} {:>12} {:>12} {:>10}\n", "benchmark", "median", "p99", "min", "ns/sample");
+            for (const Benchmark& b : benchmarks)
+            {
+                for (size_t i = 0; i < settings.warmUpRuns; ++i)
+                    b.run();
+
+                vector<double> ns(max<size_t>(settings.repetitions, 1));
+                if (counters) counters->Start();
+                for (double& t : ns)
+                {
+                    const auto start = clock::now();
+                    b.run();
+                    t = chrono::duration<double, nano>(clock::now() - start).count();
+                }
+                const PerfCounterValues events = counters ? counters->Stop() : PerfCounterValues{};
+                ranges::sort(ns);
+
+                BenchmarkStats stats;
+                stats.name          = b.name;
+                stats.samplesPerRun = b.samplesPerRun;
+                stats.repetitions   = ns.size();
+                stats.minNs    = ns.front();
+                stats.medianNs = Percentile(ns, 0.5);
+                stats.meanNs   = accumulate(ns.begin(), ns.end(), 0.0) / static_cast<double>(ns.size());
+                stats.p99Ns    = Percentile(ns, 0.99);
+
+                const double samples = static_cast<double>(b.samplesPerRun * ns.size());
+                auto PerSample = [samples](const optional<double>& v) { return v ? optional{*v / samples} : nullopt; };
+                stats.perSample = PerfCounterValues{ .cycles       = PerSample(events.cycles),
+                                                     .instructions = PerSample(events.instructions),
+                                                     .l1dMisses    = PerSample(events.l1dMisses),
+                                                     .llcMisses    = PerSample(events.llcMisses),
+                                                     .branchMisses = PerSample(events.branchMisses) };
+
+                log << format("{:<52} {:>9.1f} us {:>9.1f} us {:>9.1f} us {:>10.3f}\n", stats.name,
+                              stats.medianNs / 1000., stats.p99Ns / 1000., stats.minNs / 1000., stats.NsPerSample());
+                if (counters)
+                    log << format(" └ {}\n", stats.perSample.Summary(1.0, "sample"));
+                results.push_back(move(stats));
+            }
+        }
+
+        const std::vector<BenchmarkStats>& GetResults() const { return results; }
+
+        // One object per benchmark. 'tag' identifies the build (e.g. a commit hash).
+        void WriteJson(std::ostream& out, const std::string_view suite, const std::string_view tag) const
+        {
+            using namespace std;
+
+            const auto now = chrono::duration_cast<chrono::seconds>(chrono::system_clock::now().time_since_epoch()).count();
+            out << format("{{\n  \"suite\": \"{}\",\n  \"tag\": \"{}\",\n  \"timestamp\": {},\n", Escape(suite), Escape(tag), now);
+            out << format("  \"warm_up_runs\": {},\n  \"benchmarks\": [\n", settings.warmUpRuns);
+            // Counters the system does not provide are null
+            auto Counter = [](const optional<double>& v) { return v ? format("{:.4f}", *v) : string{"null"}; };
+            for (size_t i = 0; i < results.size(); ++i)
+            {
+                const BenchmarkStats& s = results[i];
+                const PerfCounterValues& c = s.perSample;
+                out << format("    {{ \"name\": \"{}\", \"samples_per_run\": {}, \"repetitions\": {}, "
+                              "\"min_ns\": {:.1f}, \"median_ns\": {:.1f}, \"mean_ns\": {:.1f}, \"p99_ns\": {:.1f}, "
+                              "\"ns_per_sample\": {:.4f}, \"cycles_per_sample\": {}, \"instructions_per_sample\": {}, "
+                              "\"ipc\": {}, \"l1d_misses_per_sample\": {}, \"llc_misses_per_sample\": {}, "
+                              "\"branch_misses_per_sample\": {} }}{}\n",
+                              Escape(s.name), s.samplesPerRun, s.repetitions, s.minNs, s.medianNs, s.meanNs, s.p99Ns,
+                              s.NsPerSample(), Counter(c.cycles), Counter(c.instructions), Counter(c.IPC()),
+                              Counter(c.l1dMisses), Counter(c.llcMisses), Counter(c.branchMisses),
+                              i + 1 < results.size() ? "," : "");
+            }
+            out << "  ]\n}\n";
+        }
+
+    private:
+        struct Benchmark
+        {
+            std::string name;
+            std::size_t samplesPerRun;
+            std::function<void()> run;
+        };
+
+        // Nearest-rank percentile of sorted 'values'
+        static double Percentile(const std::vector<double>& values, const double p)
+        {
+            const auto rank = static_cast<std::size_t>(std::ceil(p * static_cast<double>(values.size())));
+            return values[std::clamp<std::size_t>(rank, 1, values.size()) - 1];
+        }
+
+        static std::string Escape(const std::string_view s)
+        {
+            std::string result;
+            for (const char c : s)
+            {
+                if (c == '"' || c == '\\') result += '\\';
+                result += c;
+            }
+            return result;
+        }
+
+        MicroBenchmarkSettings settings;
+        std::vector<Benchmark> benchmarks;
+        std::vector<BenchmarkStats> results;
+    };
+
+} // namespace TRM
@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2025 Ték Róbert Máté <eppenpontaz@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+    #include <immintrin.h>
+#endif
+
+namespace TRM
+{
+namespace Pcm
+{
+
+    //------------------------------------------------------------------------
+    //  Little-endian PCM -> double
+    //
+    //  Same scaling as AudioFile: a B bit sample is divided by 2^(B-1). The
+    //  divisors are powers of two, so the SIMD kernels (which multiply by the
+    //  reciprocal) give bit-identical results to the scalar ones.
+    //  AVX2 converts 8 samples per step, SSE2 2-4 (24 bit needs SSSE3 for the
+    //  byte shuffle). The kernels never read past src + 3*n (24 bit) etc., the
+    //  last few samples are left to the scalar code.
+    //------------------------------------------------------------------------
+    inline double Int16 (const std::byte* p)
+    {
+        return static_cast<std::int16_t>(std::to_integer<std::uint16_t>(p[0]) | std::to_integer<std::uint16_t>(p[1]) << 8) / 32768.;
+    }
+
+    inline double Int24 (const std::byte* p)
+    {
+        const auto u = std::to_integer<std::uint32_t>(p[0]) << 8 | std::to_integer<std::uint32_t>(p[1]) << 16 | std::to_integer<std::uint32_t>(p[2]) << 24;
+        return (static_cast<std::int32_t>(u) >> 8) / 8388608.;
+    }
+
+    inline double Int32 (const std::byte* p)
+    {
+        const auto u = std::to_integer<std::uint32_t>(p[0])       | std::to_integer<std::uint32_t>(p[1]) << 8
+                     | std::to_integer<std::uint32_t>(p[2]) << 16 | std::to_integer<std::uint32_t>(p[3]) << 24;
+        return static_cast<std::int32_t>(u) / 2147483648.;
+    }
+
+    inline double Float32 (const std::byte* p)
+    {
+        const auto u = std::to_integer<std::uint32_t>(p[0])       | std::to_integer<std::uint32_t>(p[1]) << 8
+                     | std::to_integer<std::uint32_t>(p[2]) << 16 | std::to_integer<std::uint32_t>(p[3]) << 24;
+        return static_cast<double>(std::bit_cast<float>(u));
+    }
+
+    namespace _Impl
+    {
+        template<std::size_t Bytes, class Scalar>
+        void ScalarTail (const std::byte* src, std::size_t i, const std::size_t n, double* dst, Scalar scalar)
+        {
+            for (; i < n; ++i)
+                dst[i] = scalar(src + Bytes * i);
+        }
+
+        inline const void* At (const std::byte* src, const std::size_t offset) { return src + offset; }
+    }
+
+    // dst[i] = sample i of 'src', i < n
+    inline void Int16ToDouble (const std::byte* src, const std::size_t n, double* dst)
+    {
+        std::size_t i = 0;
+#if defined(__AVX2__)
+        const __m256d scale = _mm256_set1_pd(1. / 32768.);
+        for (; i + 8 <= n; i += 8)
+        {
+            const __m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128(static_cast<const __m128i*>(_Impl::At(src, 2 * i))));
+            _mm256_storeu_pd(dst + i,     _mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(x)),      scale));
+            _mm256_storeu_pd(dst + i + 4, _mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(x, 1)), scale));
+        }
+#elif defined(__SSE2__) || defined(_M_X64)
+        const __m128d scale = _mm_set1_pd(1. / 32768.);
+        for (; i + 4 <= n; i += 4)
+        {
+            const __m128i h = _mm_loadl_epi64(static_cast<const __m128i*>(_Impl::At(src, 2 * i)));
+            const __m128i x = _mm_srai_epi32(_mm_unpacklo_epi16(h, h), 16); // Sign extension without SSE4.1
+            _mm_storeu_pd(dst + i,     _mm_mul_pd(_mm_cvtepi32_pd(x),                       scale));
+            _mm_storeu_pd(dst + i + 2, _mm_mul_pd(_mm_cvtepi32_pd(_mm_unpackhi_epi64(x, x)), scale));
+        }
+#endif
+        _Impl::ScalarTail<2>(src, i, n, dst, Int16);
+    }
+
+    inline void Int24ToDouble (const std::byte* src, const std::size_t n, double* dst)
+    {
+        std::size_t i = 0;
+#if defined(__AVX2__) || defined(__SSSE3__)
+        // 4 samples (12 bytes) of a 16 byte load into the upper 3 bytes of 32 bit lanes, then an arithmetic shift
+        const __m128i shuffle = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+        auto Load4 = [&](const std::size_t first)
+        {
+            return _mm_srai_epi32(_mm_shuffle_epi8(_mm_loadu_si128(static_cast<const __m128i*>(_Impl::At(src, 3 * first))), shuffle), 8);
+        };
+#endif
+#if defined(__AVX2__)
+        const __m256d scale = _mm256_set1_pd(1. / 8388608.);
+        for (; i + 8 + 2 <= n; i += 8) // The second load ends 4 bytes after sample i+7
+        {
+            _mm256_storeu_pd(dst + i,     _mm256_mul_pd(_mm256_cvtepi32_pd(Load4(i)),     scale));
+            _mm256_storeu_pd(dst + i + 4, _mm256_mul_pd(_mm256_cvtepi32_pd(Load4(i + 4)), scale));
+        }
+#elif defined(__SSSE3__)
+        const __m128d scale = _mm_set1_pd(1. / 8388608.);
+        for (; i + 4 + 2 <= n; i += 4)
+        {
+            const __m128i x = Load4(i);
+            _mm_storeu_pd(dst + i,     _mm_mul_pd(_mm_cvtepi32_pd(x),                        scale));
+            _mm_storeu_pd(dst + i + 2, _mm_mul_pd(_mm_cvtepi32_pd(_mm_unpackhi_epi64(x, x)), scale));
+        }
+#endif
+        _Impl::ScalarTail<3>(src, i, n, dst, Int24);
+    }
+
+    inline void Int32ToDouble (const std::byte* src, const std::size_t n, double* dst)
+    {
+        std::size_t i = 0;
+#if defined(__AVX2__)
+        const __m256d scale = _mm256_set1_pd(1. / 2147483648.);
+        for (; i + 4 <= n; i += 4)
+            _mm256_storeu_pd(dst + i, _mm256_mul_pd(_mm256_cvtepi32_pd(_mm_loadu_si128(static_cast<const __m128i*>(_Impl::At(src, 4 * i)))), scale));
+#elif defined(__SSE2__) || defined(_M_X64)
+        const __m128d scale = _mm_set1_pd(1. / 2147483648.);
+        for (; i + 2 <= n; i += 2)
+            _mm_storeu_pd(dst + i, _mm_mul_pd(_mm_cvtepi32_pd(_mm_loadl_epi64(static_cast<const __m128i*>(_Impl::At(src, 4 * i)))), scale));
+#endif
+        _Impl::ScalarTail<4>(src, i, n, dst, Int32);
+    }
+
+    inline void Float32ToDouble (const std::byte* src, const std::size_t n, double* dst)
+    {
+        std::size_t i = 0;
+#if defined(__AVX2__)
+        for (; i + 4 <= n; i += 4)
+            _mm256_storeu_pd(dst + i, _mm256_cvtps_pd(_mm_castsi128_ps(_mm_loadu_si128(static_cast<const __m128i*>(_Impl::At(src, 4 * i))))));
+#elif defined(__SSE2__) || defined(_M_X64)
+        for (; i + 2 <= n; i += 2)
+            _mm_storeu_pd(dst + i, _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64(static_cast<const __m128i*>(_Impl::At(src, 4 * i))))));
+#endif
+        _Impl::ScalarTail<4>(src, i, n, dst, Float32);
+    }
+
+} // namespace Pcm
+} // namespace TRM
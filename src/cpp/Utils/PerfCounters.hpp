@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2025 Ték Róbert Máté <eppenpontaz@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <utility>
+#include <string_view>
+
+#ifdef __linux__
+    #include <linux/perf_event.h>
+    #include <sys/ioctl.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+namespace TRM
+{
+
+    // Counts of one measured region, a counter the system does not provide is nullopt
+    struct PerfCounterValues
+    {
+        std::optional<double> cycles;
+        std::optional<double> instructions;
+        std::optional<double> l1dMisses;
+        std::optional<double> llcMisses;
+        std::optional<double> branchMisses;
+
+        std::optional<double> IPC() const
+        {
+            if (cycles && instructions && *cycles > 0.0)
+                return *instructions / *cycles;
+            return std::nullopt;
+        }
+
+        // e.g. "12.3 cycles, 2.10 IPC, 0.01 L1d miss, 0 LLC miss, 0.20 branch miss / sample"
+        std::string Summary(const double per = 1.0, const std::string_view unit = {}) const
+        {
+            using namespace std;
+            string result;
+            auto Add = [&](const optional<double>& v, const string_view name, const bool scaled = true)
+            {
+                if (!v) return;
+                result += format("{}{:.3g} {}", result.empty() ? "" : ", ", scaled ? *v / per : *v, name);
+            };
+            Add(cycles, "cycles");
+            Add(IPC(), "IPC", false);
+            Add(l1dMisses, "L1d misses");
+            Add(llcMisses, "LLC misses");
+            Add(branchMisses, "branch misses");
+            if (result.empty())
+                return "no hardware counters";
+            return unit.empty() ? result : result + format(" (per {})", unit);
+        }
+    };
+
+    //------------------------------------------------------------------------
+    //  PerfCounters
+    //
+    //  Hardware performance counters of the calling thread via perf_event_open
+    //  (Linux only), user space only. Every counter is opened on its own, so
+    //  that one the CPU / VM / kernel settings do not allow (see
+    //  /proc/sys/kernel/perf_event_paranoid) just goes missing. Elsewhere, or
+    //  with no counters at all, Available() is false and Stop() returns empty
+    //  values, the measured code runs all the same.
+    //  Counts are scaled up when the kernel had to multiplex the counters.
+    //------------------------------------------------------------------------
+    class PerfCounters
+    {
+    public:
+        PerfCounters()
+        {
+#ifdef __linux__
+            constexpr auto Cache = [](const std::uint64_t cache, const std::uint64_t result) {
+                return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (result << 16);
+            };
+            const std::array<std::pair<std::uint32_t, std::uint64_t>, CounterCount> events = {{
+                { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+                { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+                { PERF_TYPE_HW_CACHE, Cache(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_RESULT_MISS) },
+                { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+                { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+            }};
+
+            for (std::size_t i = 0; i < CounterCount; ++i)
+            {
+                perf_event_attr attr{};
+                attr.size           = sizeof(attr);
+                attr.type           = events[i].first;
+                attr.config         = events[i].second;
+                attr.disabled       = 1;
+                attr.exclude_kernel = 1;
+                attr.exclude_hv     = 1;
+                attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+                fds[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+            }
+#endif
+        }
+
+        ~PerfCounters()
+        {
+#ifdef __linux__
+            for (const int fd : fds)
+                if (fd >= 0) close(fd);
+#endif
+        }
+
+        PerfCounters(const PerfCounters&) = delete;
+        PerfCounters& operator=(const PerfCounters&) = delete;
+
+        bool Available() const
+        {
+            for (const int fd : fds)
+                if (fd >= 0) return true;
+            return false;
+        }
+
+        void Start()
+        {
+#ifdef __linux__
+            for (const int fd : fds)
+            {
+                if (fd < 0) continue;
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+#endif
+        }
+
+        PerfCounterValues Stop()
+        {
+            std::array<std::optional<double>, CounterCount> counts{};
+#ifdef __linux__
+            for (const int fd : fds)
+                if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+
+            for (std::size_t i = 0; i < CounterCount; ++i)
+            {
+                struct { std::uint64_t value, enabled, running; } data{};
+                if (fds[i] < 0 || read(fds[i], &data, sizeof(data)) != static_cast<ssize_t>(sizeof(data)) || data.running == 0)
+                    continue;
+                counts[i] = static_cast<double>(data.value) * static_cast<double>(data.enabled) / static_cast<double>(data.running);
+            }
+#endif
+            return PerfCounterValues{ .cycles = counts[0], .instructions = counts[1], .l1dMisses = counts[2],
+                                      .llcMisses = counts[3], .branchMisses = counts[4] };
+        }
+
+    private:
+        inline static constexpr std::size_t CounterCount = 5;
+        std::array<int, CounterCount> fds{ -1, -1, -1, -1, -1 };
+    };
+
+    // Counts the hardware events of its scope and prints them when leaving it, next to a Stopwatch.
+    // 'per' divides the counts, e.g. by the number of processed samples.
+    class ScopedPerfCounters
+    {
+    public:
+        ScopedPerfCounters(std::string_view label, const double per = 1.0, std::string_view unit = {}, std::ostream& out = std::cout)
+            : label{label}, per{per}, unit{unit}, out{out}
+        {
+            counters.Start();
+        }
+
+        ~ScopedPerfCounters()
+        {
+            const PerfCounterValues values = counters.Stop();
+            if (counters.Available())
+                out << std::format("{} {}\n", label, values.Summary(per, unit));
+        }
+
+    private:
+        PerfCounters counters;
+        const std::string_view label;
+        const double per;
+        const std::string_view unit;
+        std::ostream& out;
+    };
+
+} // namespace TRM
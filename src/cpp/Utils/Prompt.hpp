@@ -18,9 +18,15 @@
 #pragma once
 
 #include <concepts>
+#include <cstdlib>
 #include <iostream>
 #include <limits>
+#include <sstream>
+#include <string>
 #include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 // Slightly over-the-top C++ template metaprogramming magic to define
 // reusable command-line prompts with automatic predicate checking.
@@ -77,15 +83,87 @@ namespace TRM
 #define PROMPT_PREFERENCES(Type, ...) \
     template<> struct TRM::PromptPreferences<Type> { using Parts = std::tuple<__VA_ARGS__>; }
 
+    namespace _Impl
+    {
+        struct PromptScript
+        {
+            bool active = false;
+            std::vector<std::string> answers;
+            std::size_t next = 0;
+        };
+
+        inline PromptScript& Script()
+        {
+            static PromptScript script;
+            return script;
+        }
+
+        [[noreturn]] inline void GiveUp(const std::string_view reason)
+        {
+            std::cout << "   " << reason << " ! Giving up.\n";
+            std::exit(EXIT_FAILURE);
+        }
+
+        // A whole argument is one answer, so strings can contain spaces
+        template<class T>
+        bool ParseAnswer(const std::string& answer, T& t)
+        {
+            if constexpr (std::is_same_v<T, std::string>)
+            {
+                t = answer;
+                return true;
+            }
+            else
+            {
+                std::istringstream in{answer};
+                return (in >> t) && (in >> std::ws).eof();
+            }
+        }
+    }
+
+    // Non-interactive mode: when the program got arguments, they answer its prompts in the order
+    // the prompts are asked, instead of the console. Nobody can be asked again, so a missing or
+    // invalid answer ends the program. This is what makes the tools usable from BatchRunner.
+    inline void AnswerPromptsFrom(const int argc, const char* const* argv)
+    {
+        auto& script = _Impl::Script();
+        script.active = argc > 1;
+        script.answers.clear();
+        for (int i = 1; i < argc; ++i)
+            script.answers.emplace_back(argv[i]);
+        script.next = 0;
+    }
+
     template<class T>
     T Prompt(const std::string_view message, std::predicate<T> auto&& predicate)
     {
         using namespace std;
 
         cout << message;
+        if (auto& script = _Impl::Script(); script.active)
+        {
+            if (script.next == script.answers.size())
+            {
+                cout << '\n';
+                _Impl::GiveUp("No answer on the command line");
+            }
+
+            const string& answer = script.answers[script.next++];
+            cout << answer << '\n';
+            T t;
+            if (!_Impl::ParseAnswer(answer, t) || !predicate(t))
+                _Impl::GiveUp("That is not valid");
+            return t;
+        }
+
         T t;
         while(!(cin >> t) || !predicate(t))
         {
+            if (cin.eof()) // Nothing more to read, e.g. started without a console and without answers
+            {
+                cout << '\n';
+                _Impl::GiveUp("No more input");
+            }
             cout << "   That is not valid ! Try again: ";
             cin.clear();
             cin.ignore(numeric_limits<streamsize>::max(), '\n');
@@ -116,6 +194,8 @@ namespace TRM
             auto obj = Prompt<T>(typename PromptPreferences<T>::Parts{});
             if (predicate(obj))
                 return obj;
+            if (_Impl::Script().active)
+                _Impl::GiveUp("That is not valid");
             cout << "   That is not valid ! Try again.\n";
         }
     }
@@ -135,7 +215,7 @@ namespace TRM
     template<class L, class R>
     struct CombinedPredicate : CombineablePredicate
     {
-        CombinedPredicate(L&& left, R&& right) : left{std::move(left)}, right{std::move(right)} {}
+        CombinedPredicate(L left, R right) : left{std::move(left)}, right{std::move(right)} {}
         bool operator()(const auto& x) const { return left(x) && right(x); }
     private:
         L left;
@@ -152,7 +232,8 @@ namespace TRM
     template<IsCombineablePredicate L, class R>
     constexpr auto operator | (L&& left, R&& right)
     {
-        return CombinedPredicate<decltype(left), decltype(right)>{std::move(left), std::move(right)};
+        // Copies, so that a combined predicate can be stored (and outlive the temporaries it was made of)
+        return CombinedPredicate<std::remove_cvref_t<L>, std::remove_cvref_t<R>>{std::forward<L>(left), std::forward<R>(right)};
     }
 
 } // namespace TRM
@@ -25,6 +25,23 @@
 namespace TRM
 {
 
+    // Prints "<message> <duration>" in µs, ms or s, whichever reads best
+    inline void PrintDuration(std::ostream& out, std::string_view message, const std::chrono::steady_clock::duration delta)
+    {
+        using namespace std;
+        using namespace std::chrono;
+        auto print = [&](auto Ratio)
+        {
+            out << format("{} {:%Q %q}\n", message, duration_cast<duration<double, decltype(Ratio)>>(delta));
+        };
+        if (delta < microseconds{1000})
+            print(micro{});
+        else if (delta < milliseconds{1000})
+            print(milli{});
+        else
+            print(ratio<1>{});
+    }
+
     class Stopwatch
     {
         using clock = std::chrono::steady_clock;
@@ -37,19 +54,7 @@ namespace TRM
 
         ~Stopwatch()
         {
-            using namespace std;
-            using namespace std::chrono;
-            const auto delta = clock::now() - startTime;
-            auto print = [&](auto Ratio)
-            {
-                out << format("{} {:%Q %q}\n", endMessage, duration_cast<duration<double, decltype(Ratio)>>(delta));
-            };
-            if (delta < microseconds{1000})
-                print(micro{});
-            else if (delta < milliseconds{1000})
-                print(milli{});
-            else
-                print(ratio<1>{});
+            PrintDuration(out, endMessage, clock::now() - startTime);
         }
 
     private:
@@ -58,4 +63,25 @@ namespace TRM
         std::ostream& out;
     };
 
+    // Adds up the time spent in Measure(), e.g. over the blocks of a streamed file
+    class CumulativeStopwatch
+    {
+        using clock = std::chrono::steady_clock;
+    public:
+        void Measure(auto&& f)
+        {
+            const auto startTime = clock::now();
+            f();
+            total += clock::now() - startTime;
+        }
+
+        void Print(std::string_view message, std::ostream& out = std::cout) const
+        {
+            PrintDuration(out, message, total);
+        }
+
+    private:
+        typename clock::duration total{};
+    };
+
 } // namespace TRM
@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2025 Ték Róbert Máté <eppenpontaz@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+    #define TRM_TRACE_HAS_TSC 1
+#elif defined(_M_X64) || defined(_M_IX86)
+    #include <intrin.h>
+    #define TRM_TRACE_HAS_TSC 1
+#endif
+
+namespace TRM
+{
+
+    //------------------------------------------------------------------------
+    //  Tracer
+    //
+    //  Timeline profiler: TRM_TRACE_ZONE("name") records when the enclosing
+    //  scope was entered and left. Every thread appends to its own buffer,
+    //  recording takes no lock and only allocates when the buffer grows.
+    //  Timestamps are raw time stamp counter ticks where available (a few ns
+    //  per zone), they are converted to microseconds when the trace is written.
+    //
+    //  The trace is written at exit as Chrome / Perfetto trace JSON (open it in
+    //  ui.perfetto.dev or chrome://tracing) to the file set by SetOutputFile(),
+    //  or to the file named by the TRM_TRACE environment variable.
+    //  Zone names must be string literals (only the pointer is stored).
+    //
+    //  Zones are compiled out unless TRM_ENABLE_TRACING is defined.
+    //------------------------------------------------------------------------
+    class Tracer
+    {
+    public:
+        // Events beyond this per thread are counted but not recorded
+        inline static constexpr std::size_t MaxEventsPerThread = std::size_t{1} << 24;
+
+        static std::uint64_t Now()
+        {
+#ifdef TRM_TRACE_HAS_TSC
+            return __rdtsc();
+#else
+            return static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+        }
+
+        static void Record(const char* name, const std::uint64_t begin, const std::uint64_t end)
+        {
+            ThreadBuffer& buffer = LocalBuffer();
+            if (buffer.events.size() < MaxEventsPerThread)
+                buffer.events.push_back(Event{ name, begin, end });
+            else
+                ++buffer.dropped;
+        }
+
+        static void SetOutputFile(std::string path)
+        {
+            std::scoped_lock lock{Instance().mutex};
+            Instance().outputFile = std::move(path);
+        }
+
+        // Writes every event recorded so far. The recording threads must have finished (or be joined).
+        static void WriteChromeTrace(std::ostream& out)
+        {
+            using namespace std;
+
+            Tracer& tracer = Instance();
+            scoped_lock lock{tracer.mutex};
+
+            // Ticks -> microseconds, measured over the lifetime of the tracer
+            const double elapsedUs = chrono::duration<double, micro>(chrono::steady_clock::now() - tracer.startTime).count();
+            const double ticks     = static_cast<double>(Now() - tracer.startTicks);
+            const double usPerTick = ticks > 0.0 ? elapsedUs / ticks : 0.0;
+            auto ToUs = [&](const uint64_t t) { return static_cast<double>(static_cast<int64_t>(t - tracer.startTicks)) * usPerTick; };
+
+            out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n";
+            const char* separator = "";
+            for (const auto& buffer : tracer.buffers)
+            {
+                out << format("{}{{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": {}, \"args\": {{\"name\": \"thread {}{}\"}}}}",
+                              separator, buffer->tid, buffer->tid,
+                              buffer->dropped > 0 ? format(" ({} events dropped)", buffer->dropped) : string{});
+                separator = ",\n";
+                for (const Event& e : buffer->events)
+                    out << format(",\n{{\"name\": \"{}\", \"ph\": \"X\", \"pid\": 1, \"tid\": {}, \"ts\": {:.3f}, \"dur\": {:.3f}}}",
+                                  e.name, buffer->tid, ToUs(e.begin), ToUs(e.end) - ToUs(e.begin));
+            }
+            out << "\n]}\n";
+        }
+
+    private:
+        struct Event
+        {
+            const char* name;
+            std::uint64_t begin;
+            std::uint64_t end;
+        };
+
+        struct ThreadBuffer
+        {
+            std::uint32_t tid = 0;
+            std::vector<Event> events;
+            std::size_t dropped = 0;
+        };
+
+        Tracer()
+        {
+            if (const char* path = std::getenv("TRM_TRACE"))
+                outputFile = path;
+        }
+
+        ~Tracer()
+        {
+            if (outputFile.empty())
+                return;
+            std::ofstream out{outputFile};
+            WriteChromeTrace(out);
+        }
+
+        static Tracer& Instance()
+        {
+            static Tracer tracer;
+            return tracer;
+        }
+
+        // Owned by the tracer, so that the events of finished threads are still written
+        static ThreadBuffer& LocalBuffer()
+        {
+            thread_local ThreadBuffer* buffer = [] {
+                Tracer& tracer = Instance();
+                std::scoped_lock lock{tracer.mutex};
+                auto& created = tracer.buffers.emplace_back(std::make_unique<ThreadBuffer>());
+                created->tid = static_cast<std::uint32_t>(tracer.buffers.size() - 1);
+                created->events.reserve(std::size_t{1} << 16);
+                return created.get();
+            }();
+            return *buffer;
+        }
+
+        std::mutex mutex;
+        std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+        std::string outputFile;
+        const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+        const std::uint64_t startTicks = Now();
+    };
+
+    class TraceZone
+    {
+    public:
+        explicit TraceZone(const char* name) : name{name}, begin{Tracer::Now()} {}
+        ~TraceZone() { Tracer::Record(name, begin, Tracer::Now()); }
+
+        TraceZone(const TraceZone&) = delete;
+        TraceZone& operator=(const TraceZone&) = delete;
+
+    private:
+        const char* name;
+        const std::uint64_t begin;
+    };
+
+} // namespace TRM
+
+// Headers that can be traced (e.g. TS808Engine.hpp) define an empty TRM_TRACE_ZONE when this header
+// was not included before them.
+#undef TRM_TRACE_ZONE
+#ifdef TRM_ENABLE_TRACING
+    #define TRM_TRACE_CONCAT_IMPL(a, b) a ## b
+    #define TRM_TRACE_CONCAT(a, b) TRM_TRACE_CONCAT_IMPL(a, b)
+    #define TRM_TRACE_ZONE(name) const ::TRM::TraceZone TRM_TRACE_CONCAT(trmTraceZone_, __LINE__){name}
+#else
+    #define TRM_TRACE_ZONE(name)
+#endif
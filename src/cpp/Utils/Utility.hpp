@@ -18,7 +18,10 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <bit>
 #include <cmath>
+#include <cstdint>
 #include <utility>
 
 inline constexpr double Eps6  = 1.e-6;
@@ -59,6 +62,13 @@ namespace TRM
         return std::lerp(lower.y, upper.y, (x - lower.x) / (upper.x - lower.x));
     }
 
+    // std::isfinite that also holds under -ffast-math, where the compiler may assume every value is finite
+    inline bool IsFinite(const double x)
+    {
+        constexpr std::uint64_t ExponentMask = 0x7ff0'0000'0000'0000;
+        return (std::bit_cast<std::uint64_t>(x) & ExponentMask) != ExponentMask;
+    }
+
     template<std::size_t N, std::size_t Start, std::size_t Sz>
     consteval auto EveryNth(const std::array<double, Sz>& arr)
     {
@@ -0,0 +1,541 @@
+/*
+ * Copyright (C) 2025 Ték Róbert Máté <eppenpontaz@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "PcmConvert.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stop_token>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Streaming WAV reader and writer, so that the offline tools don't have to hold hours of 192 kHz
+// audio in memory. Both work on fixed-size blocks of interleaved doubles: the reader decodes the
+// next blocks on a background thread while the current one is consumed, the writer encodes and
+// writes the finished blocks on a background thread while the next one is filled. Memory use is
+// (number of slots) x (block size), whatever the length of the file.
+//
+// Reads PCM 8/16/24/32 bit and float 32/64 bit files, plain or WAVE_FORMAT_EXTENSIBLE, RIFF or
+// RF64 (for files over 4 GB). Writes the same sample formats, as RIFF or as RF64 once the data
+// outgrows 4 GB.
+namespace TRM
+{
+
+    enum class WavSampleType { Int, Float };
+
+    struct WavFormat
+    {
+        std::uint32_t sampleRate = 48'000;
+        std::uint16_t channels   = 1;
+        std::uint16_t bitDepth   = 24;
+        WavSampleType sampleType = WavSampleType::Int;
+        std::uint64_t frames     = 0; // Length of the file, ignored by the writer
+
+        std::size_t BytesPerFrame() const { return channels * (bitDepth / 8u); }
+    };
+
+    namespace _Impl
+    {
+
+        // WAV headers are little-endian
+        template<class T>
+        T GetLE(const std::byte* p)
+        {
+            std::make_unsigned_t<T> result = 0;
+            for (std::size_t i = 0; i < sizeof(T); ++i)
+                result |= std::to_integer<std::make_unsigned_t<T>>(p[i]) << (8 * i);
+            return static_cast<T>(result);
+        }
+
+        template<class T>
+        std::byte* PutLE(std::byte* p, const T value)
+        {
+            const auto u = static_cast<std::make_unsigned_t<T>>(value);
+            for (std::size_t i = 0; i < sizeof(T); ++i)
+                *p++ = static_cast<std::byte>((u >> (8 * i)) & 0xFFu);
+            return p;
+        }
+
+        inline std::string_view Tag(const std::byte* p)
+        {
+            return {reinterpret_cast<const char*>(p), 4};
+        }
+
+        inline std::byte* PutTag(std::byte* p, const std::string_view tag)
+        {
+            return std::transform(tag.begin(), tag.end(), p, [](const char c){ return static_cast<std::byte>(c); });
+        }
+
+        struct WavLayout
+        {
+            WavFormat format;
+            std::uint64_t dataOffset = 0;
+        };
+
+        // Walks the chunks of a RIFF / RF64 file up to the samples.
+        // readAt(offset, dst, n) copies n bytes of the file from 'offset', false past the end of the file.
+        inline std::optional<WavLayout> ParseWavLayout(const std::uint64_t fileSize, auto&& readAt)
+        {
+            constexpr std::uint16_t FormatPCM = 1, FormatFloat = 3, FormatExtensible = 0xFFFE;
+            constexpr std::uint32_t SizeInDs64 = 0xFFFFFFFF;
+
+            std::array<std::byte, 40> buf;
+            if (!readAt(0, buf.data(), 12) || (Tag(&buf[0]) != "RIFF" && Tag(&buf[0]) != "RF64") || Tag(&buf[8]) != "WAVE")
+                return std::nullopt;
+
+            std::optional<WavFormat> format;
+            std::optional<std::uint64_t> dataOffset, dataSize;
+            std::uint64_t ds64DataSize = 0;
+            for (std::uint64_t pos = 12; (!format || !dataOffset) && readAt(pos, buf.data(), 8);)
+            {
+                const auto tag  = Tag(&buf[0]);
+                const auto size = GetLE<std::uint32_t>(&buf[4]);
+                const auto body = pos + 8;
+
+                if (tag == "ds64" && size >= 24 && readAt(body, buf.data(), 24))
+                {
+                    ds64DataSize = GetLE<std::uint64_t>(&buf[8]);
+                }
+                else if (tag == "fmt " && size >= 16 && readAt(body, buf.data(), std::min<std::size_t>(size, buf.size())))
+                {
+                    auto code = GetLE<std::uint16_t>(&buf[0]);
+                    if (code == FormatExtensible && size >= 40)
+                        code = GetLE<std::uint16_t>(&buf[24]); // The first two bytes of the sub-format GUID
+                    const WavFormat f{ .sampleRate = GetLE<std::uint32_t>(&buf[4]),
+                                       .channels   = GetLE<std::uint16_t>(&buf[2]),
+                                       .bitDepth   = GetLE<std::uint16_t>(&buf[14]),
+                                       .sampleType = code == FormatFloat ? WavSampleType::Float : WavSampleType::Int };
+                    const bool supported = (code == FormatPCM   && (f.bitDepth == 8 || f.bitDepth == 16 || f.bitDepth == 24 || f.bitDepth == 32))
+                                        || (code == FormatFloat && (f.bitDepth == 32 || f.bitDepth == 64));
+                    if (!supported || f.channels == 0 || f.sampleRate == 0)
+                        return std::nullopt;
+                    format = f;
+                }
+                else if (tag == "data")
+                {
+                    dataOffset = body;
+                    dataSize   = size == SizeInDs64 ? ds64DataSize : size;
+                }
+                pos = body + size + (size & 1u);
+            }
+            if (!format || !dataOffset)
+                return std::nullopt;
+
+            // Unfinished recordings can claim more data than there is
+            const auto available = fileSize - std::min(fileSize, *dataOffset);
+            format->frames = std::min(*dataSize, available) / format->BytesPerFrame();
+            return WavLayout{*format, *dataOffset};
+        }
+
+        // Leaves the stream at the first sample
+        inline std::optional<WavLayout> ReadWavLayout(std::istream& in)
+        {
+            in.seekg(0, std::ios::end);
+            const auto fileSize = static_cast<std::uint64_t>(in.tellg());
+            const auto layout = ParseWavLayout(fileSize, [&](const std::uint64_t offset, std::byte* dst, const std::size_t n)
+            {
+                in.clear();
+                in.seekg(static_cast<std::streamoff>(offset));
+                return static_cast<bool>(in.read(reinterpret_cast<char*>(dst), static_cast<std::streamsize>(n)));
+            });
+            in.clear();
+            if (layout)
+                in.seekg(static_cast<std::streamoff>(layout->dataOffset));
+            return layout;
+        }
+
+        // Same scaling as AudioFile, which wrote our existing files
+        inline void DecodeSamples(const WavFormat& format, const std::byte* src, std::span<double> dst)
+        {
+            switch (format.sampleType == WavSampleType::Float ? -format.bitDepth : format.bitDepth)
+            {
+            case 8:
+                std::transform(src, src + dst.size(), dst.begin(), [](const std::byte b){ return (std::to_integer<int>(b) - 128) / 128.; });
+                break;
+            case 16:  Pcm::Int16ToDouble  (src, dst.size(), dst.data()); break;
+            case 24:  Pcm::Int24ToDouble  (src, dst.size(), dst.data()); break;
+            case 32:  Pcm::Int32ToDouble  (src, dst.size(), dst.data()); break;
+            case -32: Pcm::Float32ToDouble(src, dst.size(), dst.data()); break;
+            case -64:
+                for (double& d : dst)
+                {
+                    d = std::bit_cast<double>(GetLE<std::uint64_t>(src));
+                    src += 8;
+                }
+                break;
+            }
+        }
+
+        inline void EncodeSamples(const WavFormat& format, std::span<const double> src, std::byte* dst)
+        {
+            auto Convert = [&](auto put)
+            {
+                for (const double s : src)
+                    dst = put(dst, s);
+            };
+            auto Clamp = [](const double s){ return std::clamp(s, -1., 1.); };
+            switch (format.sampleType == WavSampleType::Float ? -format.bitDepth : format.bitDepth)
+            {
+            case 8:   Convert([&](std::byte* p, const double s){ *p = static_cast<std::byte>(static_cast<int>(Clamp(s) * 127.) + 128); return p + 1; }); break;
+            case 16:  Convert([&](std::byte* p, const double s){ return PutLE(p, static_cast<std::int16_t>(Clamp(s) * 32767.)); }); break;
+            case 24:  Convert([&](std::byte* p, const double s){ PutLE(p, static_cast<std::int32_t>(Clamp(s) * 8388607.)); return p + 3; }); break; // Writes a 4th byte, see WavWriter
+            case 32:  Convert([&](std::byte* p, const double s){ return PutLE(p, static_cast<std::int32_t>(Clamp(s) * 2147483647.)); }); break;
+            case -32: Convert([&](std::byte* p, const double s){ return PutLE(p, std::bit_cast<std::uint32_t>(static_cast<float>(s))); }); break;
+            case -64: Convert([&](std::byte* p, const double s){ return PutLE(p, std::bit_cast<std::uint64_t>(s)); }); break;
+            }
+        }
+
+    } // namespace _Impl
+
+    // Only reads the header, std::nullopt if the file can't be read or has an unsupported format
+    inline std::optional<WavFormat> ReadWavFormat(const std::filesystem::path& path)
+    {
+        std::ifstream in{path, std::ios::binary};
+        if (auto layout = _Impl::ReadWavLayout(in))
+            return layout->format;
+        return std::nullopt;
+    }
+
+    inline constexpr std::size_t DefaultWavBlockFrames = 1u << 15;
+
+    class WavReader
+    {
+    public:
+        // 'readAhead' blocks are decoded in advance, on top of the one being consumed
+        explicit WavReader(const std::filesystem::path& path,
+                           const std::size_t blockFrames = DefaultWavBlockFrames,
+                           const std::size_t readAhead = 2)
+            : file{path, std::ios::binary}
+        {
+            const auto layout = _Impl::ReadWavLayout(file);
+            if (!layout || blockFrames == 0)
+                return;
+
+            format = layout->format;
+            slots.resize(readAhead + 1);
+            for (auto& slot : slots)
+                slot.samples.resize(blockFrames * format.channels);
+            worker = std::jthread{[this](std::stop_token stop){ Decode(stop); }};
+        }
+
+        WavReader(const WavReader&) = delete;
+        WavReader& operator=(const WavReader&) = delete;
+
+        explicit operator bool() const { return worker.joinable(); }
+
+        const WavFormat& Format() const { return format; }
+
+        // The next block of interleaved samples, shorter at the end of the file and empty after it.
+        // Stays valid until the next call. Don't mix with NextFrame().
+        std::span<const double> NextBlock()
+        {
+            std::unique_lock lock{mutex};
+            if (holding)
+            {
+                ++released;
+                holding = false;
+                cv.notify_all();
+            }
+            cv.wait(lock, [&]{ return decoded > released || finished; });
+            if (decoded == released)
+                return {};
+
+            holding = true;
+            const auto& slot = slots[released % slots.size()];
+            return std::span{slot.samples}.first(slot.frames * format.channels);
+        }
+
+        // The next frame (one sample per channel), empty after the end of the file.
+        // Skips 'stride' - 1 frames after it, NextFrame(4) steps through the file at a quarter of its sample rate.
+        std::span<const double> NextFrame(const std::size_t stride = 1)
+        {
+            for (;;)
+            {
+                if (pos == block.size())
+                {
+                    block = NextBlock();
+                    pos   = 0;
+                    if (block.empty())
+                        return {};
+                }
+                const std::size_t skipped = std::min(toSkip, (block.size() - pos) / format.channels);
+                pos    += skipped * format.channels;
+                toSkip -= skipped;
+                if (toSkip == 0 && pos < block.size())
+                    break;
+            }
+            const auto frame = block.subspan(pos, format.channels);
+            pos   += format.channels;
+            toSkip = stride - 1;
+            return frame;
+        }
+
+    private:
+        void Decode(std::stop_token stop)
+        {
+            const std::size_t blockFrames = slots.front().samples.size() / format.channels;
+            std::vector<std::byte> raw(blockFrames * format.BytesPerFrame());
+            for (std::uint64_t framesLeft = format.frames; framesLeft > 0;)
+            {
+                {
+                    std::unique_lock lock{mutex};
+                    if (!cv.wait(lock, stop, [&]{ return decoded - released < slots.size(); }))
+                        return;
+                }
+
+                auto& slot = slots[decoded % slots.size()];
+                slot.frames = static_cast<std::size_t>(std::min<std::uint64_t>(framesLeft, blockFrames));
+                const auto bytes = static_cast<std::streamsize>(slot.frames * format.BytesPerFrame());
+                if (!file.read(reinterpret_cast<char*>(raw.data()), bytes))
+                    break;
+                _Impl::DecodeSamples(format, raw.data(), std::span{slot.samples}.first(slot.frames * format.channels));
+                framesLeft -= slot.frames;
+
+                std::lock_guard lock{mutex};
+                ++decoded;
+                cv.notify_all();
+            }
+            std::lock_guard lock{mutex};
+            finished = true;
+            cv.notify_all();
+        }
+
+        struct Slot
+        {
+            std::vector<double> samples;
+            std::size_t frames = 0;
+        };
+
+        std::ifstream file;
+        WavFormat format{};
+        std::vector<Slot> slots;
+
+        std::mutex mutex;
+        std::condition_variable_any cv;
+        std::uint64_t decoded  = 0; // Blocks handed over by the background thread
+        std::uint64_t released = 0; // Blocks given back by the consumer
+        bool holding  = false;      // The consumer is reading block 'released'
+        bool finished = false;
+
+        std::span<const double> block; // NextFrame() state
+        std::size_t pos    = 0;
+        std::size_t toSkip = 0;
+
+        std::jthread worker; // Last, so that it is stopped before the rest is destroyed
+    };
+
+    class WavWriter
+    {
+    public:
+        // Up to 'writeBehind' finished blocks are queued for writing, on top of the one being filled
+        WavWriter(const std::filesystem::path& path, const WavFormat& format,
+                  const std::size_t blockFrames = DefaultWavBlockFrames,
+                  const std::size_t writeBehind = 2)
+            : file{path, std::ios::binary}
+            , format{format}
+        {
+            if (!file || blockFrames == 0 || format.channels == 0 || !WriteHeader())
+                return;
+
+            slots.resize(writeBehind + 1);
+            for (auto& slot : slots)
+                slot.resize(blockFrames * format.channels);
+            sizes.resize(slots.size());
+            filling = slots.front();
+            worker = std::jthread{[this]{ Encode(); }};
+        }
+
+        WavWriter(const WavWriter&) = delete;
+        WavWriter& operator=(const WavWriter&) = delete;
+
+        ~WavWriter() { Close(); }
+
+        explicit operator bool() const { return worker.joinable() && !failed; }
+
+        // Samples go in interleaved, one per channel makes a frame
+        void Write(const double sample)
+        {
+            filling[filled++] = sample;
+            if (filled == filling.size())
+                Submit();
+        }
+
+        void Write(std::span<const double> samples)
+        {
+            while (!samples.empty())
+            {
+                const std::size_t n = std::min(samples.size(), filling.size() - filled);
+                std::copy_n(samples.begin(), n, filling.begin() + static_cast<std::ptrdiff_t>(filled));
+                samples = samples.subspan(n);
+                filled += n;
+                if (filled == filling.size())
+                    Submit();
+            }
+        }
+
+        // Flushes the last block (an incomplete frame is padded with zeros) and finalizes the header.
+        // False if anything went wrong, the destructor calls it too.
+        bool Close()
+        {
+            if (!worker.joinable())
+                return false;
+
+            while (filled % format.channels != 0)
+                Write(0.0);
+            if (filled > 0)
+                Submit();
+            {
+                std::lock_guard lock{mutex};
+                closing = true;
+                cv.notify_all();
+            }
+            worker.join();
+            return FinishHeader() && !failed;
+        }
+
+    private:
+        // Hands the filled slot to the background thread and waits for a free one
+        void Submit()
+        {
+            std::unique_lock lock{mutex};
+            sizes[submitted % sizes.size()] = filled;
+            ++submitted;
+            cv.notify_all();
+            cv.wait(lock, [&]{ return submitted - written < slots.size(); });
+            filling = slots[submitted % slots.size()];
+            filled  = 0;
+        }
+
+        void Encode()
+        {
+            std::vector<std::byte> raw(slots.front().size() * (format.bitDepth / 8u) + 1); // +1: the 24 bit encoder writes a 4th byte
+            for (;;)
+            {
+                std::size_t samples = 0;
+                {
+                    std::unique_lock lock{mutex};
+                    cv.wait(lock, [&]{ return written < submitted || closing; });
+                    if (written == submitted)
+                        return;
+                    samples = sizes[written % sizes.size()];
+                }
+
+                const auto& slot = slots[written % slots.size()];
+                _Impl::EncodeSamples(format, std::span{slot}.first(samples), raw.data());
+                const auto bytes = samples * (format.bitDepth / 8u);
+                if (!file.write(reinterpret_cast<const char*>(raw.data()), static_cast<std::streamsize>(bytes)))
+                    failed = true;
+                dataBytes += bytes;
+
+                std::lock_guard lock{mutex};
+                ++written;
+                cv.notify_all();
+            }
+        }
+
+        // RIFF header, a JUNK chunk that becomes the ds64 chunk of an RF64 file, fmt, data
+        static constexpr std::size_t HeaderSize = 80;
+
+        bool WriteHeader()
+        {
+            using namespace _Impl;
+            std::array<std::byte, HeaderSize> h{};
+            auto p = PutTag(h.data(), "RIFF");
+            p = PutLE<std::uint32_t>(p, 0);
+            p = PutTag(p, "WAVE");
+            p = PutTag(p, "JUNK");
+            p = PutLE<std::uint32_t>(p, 28) + 28;
+            p = PutTag(p, "fmt ");
+            p = PutLE<std::uint32_t>(p, 16);
+            p = PutLE<std::uint16_t>(p, format.sampleType == WavSampleType::Float ? 3 : 1);
+            p = PutLE<std::uint16_t>(p, format.channels);
+            p = PutLE<std::uint32_t>(p, format.sampleRate);
+            p = PutLE<std::uint32_t>(p, static_cast<std::uint32_t>(format.sampleRate * format.BytesPerFrame()));
+            p = PutLE<std::uint16_t>(p, static_cast<std::uint16_t>(format.BytesPerFrame()));
+            p = PutLE<std::uint16_t>(p, format.bitDepth);
+            p = PutTag(p, "data");
+            PutLE<std::uint32_t>(p, 0);
+            return static_cast<bool>(file.write(reinterpret_cast<const char*>(h.data()), h.size()));
+        }
+
+        bool FinishHeader()
+        {
+            using namespace _Impl;
+            if (dataBytes % 2 != 0)
+                file.put('\0'); // Chunks are padded to an even size
+
+            const std::uint64_t riffSize = HeaderSize - 8 + dataBytes + dataBytes % 2;
+            const bool rf64 = riffSize > 0xFFFFFFFF;
+            auto Patch = [&](const std::streamoff offset, auto... fields)
+            {
+                std::array<std::byte, 28> buf;
+                auto p = buf.data();
+                ((p = PutLE(p, fields)), ...);
+                file.seekp(offset);
+                file.write(reinterpret_cast<const char*>(buf.data()), p - buf.data());
+            };
+            if (rf64)
+            {
+                file.seekp(0);
+                file.write("RF64", 4);
+                Patch(4, std::uint32_t{0xFFFFFFFF});
+                file.write("WAVEds64", 8);
+                Patch(20, riffSize, dataBytes, dataBytes / format.BytesPerFrame(), std::uint32_t{0});
+                Patch(HeaderSize - 4, std::uint32_t{0xFFFFFFFF});
+            }
+            else
+            {
+                Patch(4, static_cast<std::uint32_t>(riffSize));
+                Patch(HeaderSize - 4, static_cast<std::uint32_t>(dataBytes));
+            }
+            file.close();
+            return !file.fail();
+        }
+
+        std::ofstream file;
+        const WavFormat format;
+        std::vector<std::vector<double>> slots;
+
+        std::span<double> filling; // The slot being filled, by the producer
+        std::size_t filled = 0;
+
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::vector<std::size_t> sizes; // Samples in each slot
+        std::uint64_t submitted = 0;    // Blocks handed over by the producer
+        std::uint64_t written   = 0;    // Blocks written by the background thread
+        bool closing = false;
+        std::atomic<bool> failed = false;
+        std::uint64_t dataBytes = 0;
+
+        std::jthread worker;
+    };
+
+} // namespace TRM
@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2025 Ték Róbert Máté <eppenpontaz@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "MicroBenchmark.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <numbers>
+#include <vector>
+
+// NumMethods and the TS808VST core both define TRM::Decimation and TRM::Measurement,
+// so their kernels are registered from separate translation units.
+void RegisterNumMethodsKernels (TRM::MicroBenchmarkSuite& suite);
+void RegisterTS808Kernels (TRM::MicroBenchmarkSuite& suite);
+
+// Number of samples every kernel benchmark processes per run
+inline constexpr std::size_t KernelSamples = 1 << 14;
+
+// Synthetic guitar-like signal: a few decaying partials, re-plucked every second
+inline std::vector<double> SyntheticGuitar (const std::size_t length, const double sampleRate, const double amplitude = 0.2)
+{
+    std::vector<double> signal(length);
+    for (std::size_t i = 0; i < length; ++i)
+    {
+        const double t     = std::fmod(static_cast<double>(i) / sampleRate, 1.0);
+        const double decay = std::exp(-3. * t);
+        double s = 0.0;
+        for (int k = 1; k <= 5; ++k)
+            s += std::sin(2. * std::numbers::pi * 110. * k * t) * decay / k;
+        signal[i] = amplitude * s;
+    }
+    return signal;
+}
@@ -0,0 +1,317 @@
+/*
+ * Copyright (C) 2025 Ték Róbert Máté <eppenpontaz@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Kernels.hpp"
+
+#include "Decimation.hpp"
+#include "FIR.hpp"
+#include "Lanes.hpp"
+#include "MirroredRing.hpp"
+#include "NewMethod.hpp"
+#include "RungeKutta4.hpp"
+#include "SimdFIR.hpp"
+#include "TS808Components.hpp"
+#include "Utility.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <format>
+#include <memory>
+#include <numbers>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+using namespace std;
+using namespace TRM;
+
+namespace
+{
+
+    // 192 kHz -> 48 kHz, 'Decimator' is D4x, D4x_Poly or D4x_HalfBand
+    template<class Decimator, size_t ChunkSz>
+    void AddDecimator (MicroBenchmarkSuite& suite, const string& name)
+    {
+        auto in  = make_shared<vector<double>>(SyntheticGuitar(KernelSamples, 192'000.));
+        auto out = make_shared<vector<double>>(KernelSamples / 4);
+        auto decimator = make_shared<Decimator>();
+
+        suite.Add(format("{} (chunk size = {})", name, ChunkSz), KernelSamples, [=]
+        {
+            auto src = in->cbegin();
+            auto dst = out->begin();
+            for (size_t i = 0; i < KernelSamples / ChunkSz; ++i)
+            {
+                src = decimator->Load(src);
+                dst = decimator->Apply(dst);
+            }
+            DoNotOptimize(out->back());
+        });
+    }
+
+    // A 32 tap FIR fed in blocks of BlockSz samples, with its history kept in two ways:
+    //  - copy-shift: the history and the block in a work buffer, the history shifted back to its
+    //    front after every block (the scheme MirroredRing replaced, here also for blocks shorter
+    //    than the filter)
+    //  - MirroredRing: written and read in place, the history mirrored back once every 128 samples
+    //    (the slide of TS808Engine's rings)
+    template<size_t BlockSz>
+    void AddHistory (MicroBenchmarkSuite& suite)
+    {
+        constexpr size_t Taps = 32;
+        constexpr size_t History = Taps - 1;
+        static constexpr array<double, Taps> Coeffs = []
+        {
+            array<double, Taps> c{};
+            double sum = 0.0;
+            for (size_t k = 0; k < Taps; ++k)
+                sum += c[k] = static_cast<double>((k + 1) * (Taps - k));
+            for (double& d : c)
+                d /= sum;
+            return c;
+        }();
+
+        auto in  = make_shared<vector<double>>(SyntheticGuitar(KernelSamples, 48'000.));
+        auto out = make_shared<vector<double>>(KernelSamples);
+
+        auto Filter = [out](const double* window, const size_t offset)
+        {
+            Simd::FIR_Contiguous(1, BlockSz, [&](const size_t m, const double y) { (*out)[offset + m] = y; },
+                                 Simd::FIR_Branch{Coeffs, window});
+        };
+
+        auto work = make_shared<array<double, History + BlockSz>>();
+        suite.Add(format("FIR history, copy-shift (block size = {})", BlockSz), KernelSamples, [=]
+        {
+            double* const buf = work->data();
+            for (size_t i = 0; i < KernelSamples; i += BlockSz)
+            {
+                copy_n(in->data() + i, BlockSz, buf + History);
+                Filter(buf, i);
+                copy(buf + BlockSz, buf + BlockSz + History, buf);
+            }
+            DoNotOptimize(out->back());
+        });
+
+        auto ring = make_shared<MirroredRing<double, History, BlockSz, 128>>();
+        suite.Add(format("FIR history, MirroredRing (block size = {})", BlockSz), KernelSamples, [=]
+        {
+            for (size_t i = 0; i < KernelSamples; i += BlockSz)
+            {
+                copy_n(in->data() + i, BlockSz, ring->Block());
+                Filter(ring->Window(), i);
+                ring->Advance(BlockSz);
+            }
+            DoNotOptimize(out->back());
+        });
+    }
+
+    // The diode clipper ODE of DiodeClipper_RK4 at 48 kHz, with the feedback resistance 'rf'.
+    // 'State' is double, or Lanes<N> for N circuits with different resistances (one per lane).
+    template<class State>
+    auto DiodeClipperODE (const vector<double>& in96, const vector<double>& din96, const State rf)
+    {
+        return [&in = in96, &din = din96, rf, cur = 0]<class T>(const T&, const State& x) mutable
+        {
+            if constexpr (is_same_v<T, RK4::TimeStep>)
+            {
+                cur += 2;
+                return;
+            }
+            else
+            {
+                const size_t idx   = static_cast<size_t>(cur) + T::lookahead;
+                const State  delta = x - State{in[idx]};
+                State current;
+                if constexpr (IsLanes<State>)
+                    for (size_t i = 0; i < LaneCount<State>; ++i) current[i] = AntiParallel_1N4148_Current(delta[i]);
+                else
+                    current = AntiParallel_1N4148_Current(delta);
+                return din[idx] + (in[idx]/Rg - delta/rf - current) / Cf;
+            }
+        };
+    }
+
+    // An analytic input (and its derivative) at 96 kHz for 'steps' RK4 steps at 48 kHz, 'amplitude' in Volts
+    auto DiodeClipperInput (const size_t steps, const double amplitude)
+    {
+        constexpr double Omega = 2. * numbers::pi * 220.;
+
+        auto in96  = make_shared<vector<double>>(2 * steps + 3);
+        auto din96 = make_shared<vector<double>>(2 * steps + 3);
+        for (size_t i = 0; i < in96->size(); ++i)
+        {
+            const double t = static_cast<double>(i) / 96'000.;
+            (*in96)[i]  = amplitude * sin(Omega * t);
+            (*din96)[i] = amplitude * Omega * cos(Omega * t);
+        }
+        return pair{in96, din96};
+    }
+
+    // Explicit RK4 at 48 kHz is only stable while h * (1/Rf + diode conductance) / Cf stays below ~2.8,
+    // i.e. for Rf above ~150k and barely conducting diodes. The RK4 entries run the circuit from MinRf up,
+    // with an input small enough (the diode voltages peak at 0.04 .. 0.12 V) that every circuit stays
+    // finite, 3x below the amplitude where the first one diverges.
+    constexpr double MinRf = 200'000.;
+    constexpr double StableAmplitude = 1e-3; // Volts
+
+    // A diverged executor is timed on NaNs and infinities, not on the circuit
+    void CheckFinite (const double x, const string_view name)
+    {
+        if (!IsFinite(x))
+            throw runtime_error(format("{}: the output is not finite", name));
+    }
+
+    template<size_t N>
+    void CheckFinite (const Lanes<N>& x, const string_view name)
+    {
+        for (size_t i = 0; i < N; ++i)
+            CheckFinite(x[i], name);
+    }
+
+    void AddRK4 (MicroBenchmarkSuite& suite)
+    {
+        constexpr size_t Steps = KernelSamples;
+        const auto [in96, din96] = DiodeClipperInput(Steps, StableAmplitude);
+
+        constexpr string_view Name = "RK4::Executor (diode clipper ODE, 48 kHz)";
+        suite.Add(string{Name}, Steps, [=]
+        {
+            RK4::Executor rk4{integral_constant<double, 1. / 48'000>{}, 0.0, DiodeClipperODE(*in96, *din96, MinRf)};
+            double y = 0.0;
+            for (size_t k = 0; k < Steps; ++k)
+            {
+                y = rk4.DoOneStep();
+                DoNotOptimize(y);
+            }
+            CheckFinite(y, Name);
+        });
+    }
+
+    // A sweep of the drive knob over N circuits: N scalar executors one after the other, and one executor
+    // of the whole ensemble, a circuit per lane. ns/sample is per step of one circuit.
+    template<size_t N>
+    void AddRK4Ensemble (MicroBenchmarkSuite& suite)
+    {
+        constexpr size_t Steps = KernelSamples;
+        const auto [in96, din96] = DiodeClipperInput(Steps, StableAmplitude);
+
+        auto SweptRf = [](const size_t i) { return MinRf + static_cast<double>(i) / static_cast<double>(N) * Rd; };
+
+        const string scalarName = format("RK4::Executor x {} (drive sweep)", N);
+        suite.Add(scalarName, N * Steps, [=]
+        {
+            for (size_t i = 0; i < N; ++i)
+            {
+                RK4::Executor rk4{integral_constant<double, 1. / 48'000>{}, 0.0, DiodeClipperODE(*in96, *din96, SweptRf(i))};
+                double y = 0.0;
+                for (size_t k = 0; k < Steps; ++k)
+                {
+                    y = rk4.DoOneStep();
+                    DoNotOptimize(y);
+                }
+                CheckFinite(y, scalarName);
+            }
+        });
+
+        const string ensembleName = format("RK4::Executor<Lanes<{}>> (drive sweep)", N);
+        suite.Add(ensembleName, N * Steps, [=]
+        {
+            Lanes<N> rf;
+            for (size_t i = 0; i < N; ++i) rf[i] = SweptRf(i);
+            RK4::Executor rk4{integral_constant<double, 1. / 48'000>{}, Lanes<N>{0.0}, DiodeClipperODE(*in96, *din96, rf)};
+            Lanes<N> y{0.0};
+            for (size_t k = 0; k < Steps; ++k)
+            {
+                y = rk4.DoOneStep();
+                DoNotOptimize(y);
+            }
+            CheckFinite(y, ensembleName);
+        });
+    }
+
+    // The diode clipper of DiodeClipper_NewMethod, the input derivatives are analytic instead of finite differences
+    void AddNewMethod (MicroBenchmarkSuite& suite)
+    {
+        constexpr size_t Steps = KernelSamples;
+        constexpr double h = 1. / 48'000.;
+        constexpr double Omega = 2. * numbers::pi * 220.;
+        constexpr double Amplitude = 0.5; // Volts
+
+        constexpr double VT = 0.02677;
+        constexpr double n  = 1.92;
+        constexpr double A = 1. / (Rg * Cf);
+        constexpr double B = -Rf / Cf;
+        constexpr double D = 1. / (VT * n);
+        constexpr double C = (-2.) * D / Cf;
+
+        suite.Add("NewMethod::Executor (diode clipper ODE, 48 kHz)", Steps, [=]
+        {
+            auto derivatives = [step = size_t{0}](const double delta) mutable
+            {
+                const double phase = Omega * static_cast<double>(step++) * h;
+                const double s = Amplitude * sin(phase), c = Amplitude * cos(phase);
+                const double S = sinh(D*delta);
+                const double K = cosh(D*delta);
+                const double f0 = A*s + B*delta + C*S;
+                const double f1 = A*Omega*c + f0*(B + C*D*K);
+                const double f2 = -A*Omega*Omega*s + f1*(B + C*D*K) + C*D*D*f0*f0*S;
+                const double f3 = -A*Omega*Omega*Omega*c + f2*(B + C*D*K) + 3*C*D*D*f0*f1*S + C*D*D*D*f0*f0*f0*K;
+                const double f4 = A*Omega*Omega*Omega*Omega*s + f3*(B + C*D*K) + 4*C*D*D*f0*f2*S + 6*C*D*D*D*f0*f0*f1*K + 3*C*D*D*f1*f1*S + C*D*D*D*D*f0*f0*f0*f0*S;
+                return NewMethod::Derivatives{.first = f0, .second = f1, .third = f2, .fourth = f3, .fifth = f4};
+            };
+            NewMethod::Executor x(h, 0.0, move(derivatives));
+            for (size_t k = 0; k < Steps; ++k)
+                DoNotOptimize(x.DoOneStep());
+        });
+    }
+
+} // namespace
+
+void RegisterNumMethodsKernels (MicroBenchmarkSuite& suite)
+{
+    using enum FIRKernel;
+    AddDecimator<Decimation::D4x<128, false, Vectorized>, 128>(suite, "FIR_Base / D4x, 192 -> 48 kHz");
+    AddDecimator<Decimation::D4x<128, false, Folded>, 128>(suite, "FIR_Base / D4x, folded, 192 -> 48 kHz");
+    AddDecimator<Decimation::D4x_Poly<128, false, Vectorized>, 128>(suite, "D4x_Poly, 192 -> 48 kHz");
+    AddDecimator<Decimation::D4x_Poly<128, false, Folded>, 128>(suite, "D4x_Poly, folded, 192 -> 48 kHz");
+    AddDecimator<Decimation::D4x_HalfBand<128, false, Vectorized>, 128>(suite, "D4x_HalfBand, 192 -> 48 kHz");
+    AddDecimator<Decimation::D4x_HalfBand<128, false, Folded>, 128>(suite, "D4x_HalfBand, folded, 192 -> 48 kHz");
+    AddDecimator<Decimation::D4x<1024, false, Vectorized>, 1024>(suite, "FIR_Base / D4x, 192 -> 48 kHz");
+    AddDecimator<Decimation::D4x<1024, false, Folded>, 1024>(suite, "FIR_Base / D4x, folded, 192 -> 48 kHz");
+    AddDecimator<Decimation::D4x_Poly<1024, false, Vectorized>, 1024>(suite, "D4x_Poly, 192 -> 48 kHz");
+    AddDecimator<Decimation::D4x_Poly<1024, false, Folded>, 1024>(suite, "D4x_Poly, folded, 192 -> 48 kHz");
+    AddDecimator<Decimation::D4x_HalfBand<1024, false, Vectorized>, 1024>(suite, "D4x_HalfBand, 192 -> 48 kHz");
+    AddDecimator<Decimation::D4x_HalfBand<1024, false, Folded>, 1024>(suite, "D4x_HalfBand, folded, 192 -> 48 kHz");
+    AddHistory<1>(suite);
+    AddHistory<2>(suite);
+    AddHistory<4>(suite);
+    AddHistory<8>(suite);
+    AddHistory<16>(suite);
+    AddHistory<32>(suite);
+    AddHistory<64>(suite);
+    AddRK4(suite);
+    AddRK4Ensemble<1>(suite);
+    AddRK4Ensemble<2>(suite);
+    AddRK4Ensemble<4>(suite);
+    AddRK4Ensemble<8>(suite);
+    AddNewMethod(suite);
+}
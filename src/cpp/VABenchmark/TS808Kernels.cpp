@@ -0,0 +1,309 @@
+/*
+ * Copyright (C) 2025 Ték Róbert Máté <eppenpontaz@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Kernels.hpp"
+
+#include "TS808Engine.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <format>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+using namespace std;
+using namespace TRM;
+
+namespace
+{
+
+    // The four polyphase branches of the engine's 4x decimator, one output sample per 4 inputs
+    void AddPolyBase (MicroBenchmarkSuite& suite)
+    {
+        constexpr size_t Taps = Decimation::D4x_Poly_Taps;
+        constexpr size_t Outputs = KernelSamples / 4;
+
+        // Branch p holds every 4th input sample, preceded by the Taps-1 samples of history
+        auto poly = make_shared<array<vector<double>, 4>>();
+        const auto in = SyntheticGuitar(KernelSamples + 4 * (Taps - 1), 192'000.);
+        for (size_t p = 0; p < 4; ++p)
+            for (size_t i = p; i < in.size(); i += 4)
+                (*poly)[p].push_back(in[i]);
+        auto out = make_shared<vector<double>>(Outputs);
+
+        suite.Add("Decimation::Poly_Base (4 x 27 taps), 192 -> 48 kHz", KernelSamples, [=]
+        {
+            Decimation::D4x_Poly_1 d1;
+            Decimation::D4x_Poly_2 d2;
+            Decimation::D4x_Poly_3 d3;
+            Decimation::D4x_Poly_4 d4;
+            auto windowEnd = [&](const size_t p, const size_t i) { return (*poly)[p].cbegin() + Taps + i; };
+            for (size_t i = 0; i < Outputs; ++i)
+                (*out)[i] = d1.Apply(windowEnd(0, i)) + d2.Apply(windowEnd(1, i)) + d3.Apply(windowEnd(2, i)) + d4.Apply(windowEnd(3, i));
+            DoNotOptimize(out->back());
+        });
+
+        // The engine's path: every output in one multiply-add chain, several outputs per pass
+        auto AddBlock = [&]<bool Fold>(const string& name)
+        {
+            suite.Add(name, KernelSamples, [=]
+            {
+                auto first = [&](const size_t p) { return (*poly)[p].data(); };
+                Decimation::ApplyBlock<Fold, Decimation::D4x_Poly_1, Decimation::D4x_Poly_2, Decimation::D4x_Poly_3, Decimation::D4x_Poly_4>(
+                    Outputs, [&](const size_t i, const double y) { (*out)[i] = y; }, first(0), first(1), first(2), first(3));
+                DoNotOptimize(out->back());
+            });
+        };
+        AddBlock.template operator()<false>("Decimation::ApplyBlock, SIMD (4 x 27 taps), 192 -> 48 kHz");
+        AddBlock.template operator()<true>("Decimation::ApplyBlock, folded (4 x 27 taps), 192 -> 48 kHz");
+    }
+
+    // 48 kHz -> 192 kHz, samples and derivatives (in units of 1 / second). ns/sample is per input sample.
+    // Output 4i+r is at t = (r+1) / 4 between in[i+1] and in[i+2], the last phase is in[i+2] itself.
+    struct SampleAndDerivative
+    {
+        double sample = 0.0;
+        double derivative = 0.0;
+    };
+
+    // The hand-written upsampler of the original processImpl (TS808Benchmark/TS808Reference.hpp),
+    // 'din' is in units of 1 / second
+    void UpsampleBasicFIR (const vector<double>& in, const vector<double>& din, vector<SampleAndDerivative>& out)
+    {
+        constexpr double h = 1. / 48'000.;
+
+        constexpr auto a  = Basic_FIR(3283., 165375., 25725., 2225.);
+        constexpr auto b  = Basic_FIR(13., 243., 243., 13.);
+        constexpr auto c  = Basic_FIR(2225., 25725., 165375., 3283.);
+        constexpr auto da = Basic_FIR(735.*h, 33075.*h, -11025.*h, -525.*h);
+        constexpr auto db = Basic_FIR(3.*h, 81.*h, -81.*h, -3.*h);
+        constexpr auto dc = Basic_FIR(525.*h, 11025.*h, -33075.*h, -735.*h);
+
+        constexpr auto d_a  = Basic_FIR(11935., -174825., 152145., 10745.);
+        constexpr auto d_b  = Basic_FIR(-5., -405., 405., 5.);
+        constexpr auto d_c  = Basic_FIR(-10745., -152145., 174825., -11935.);
+        constexpr auto d_da = Basic_FIR(2751.*h, 44415.*h, -58905.*h, -2505.*h);
+        constexpr auto d_db = Basic_FIR(-1.*h, -81.*h, -81.*h, -1.*h);
+        constexpr auto d_dc = Basic_FIR(-2505.*h, -58905.*h, 44415.*h, 2751.*h);
+
+        for (size_t i = 0; i + 3 < in.size(); ++i)
+        {
+            auto dst = [&](const size_t r) -> SampleAndDerivative& { return out[i * 4 + r]; };
+            const auto x  = in.cbegin()  + static_cast<ptrdiff_t>(i);
+            const auto dx = din.cbegin() + static_cast<ptrdiff_t>(i);
+
+            dst(0).sample = (a(x) + da(dx)) / 196608.;
+            dst(1).sample = (b(x) + db(dx)) / 512.;
+            dst(2).sample = (c(x) + dc(dx)) / 196608.;
+            dst(0).derivative = (d_a(x) + d_da(dx)) / (147456. * h);
+            dst(1).derivative = (d_b(x) + d_db(dx)) / (256. * h);
+            dst(2).derivative = (d_c(x) + d_dc(dx)) / (147456. * h);
+            dst(3).sample = x[2];
+            dst(3).derivative = dx[2];
+        }
+    }
+
+    // The engine's upsampler: Hermite7 weights, mirrored phases folded (see TS808Engine::ProcessImpl),
+    // 'din' is in units of 1 / input sample period
+    void UpsampleFoldedHermite (const vector<double>& in, const vector<double>& din, vector<SampleAndDerivative>& out)
+    {
+        constexpr double SampleRate = 48'000.;
+        constexpr FoldedHermitePhase Quarter = FoldHermite(Hermite7(0.25));
+        constexpr FoldedHermitePhase Half    = FoldHermite(Hermite7(0.5));
+
+        auto Apply = [](const FoldedHermiteWeights& w, const auto& xSum, const auto& xDiff,
+                        const auto& dxSum, const auto& dxDiff) -> pair<double, double> {
+            const double even = w.xEven[0] * xSum[0] + w.xEven[1] * xSum[1] + w.dxOdd[0]  * dxDiff[0] + w.dxOdd[1]  * dxDiff[1];
+            const double odd  = w.xOdd[0] * xDiff[0] + w.xOdd[1] * xDiff[1] + w.dxEven[0] * dxSum[0]  + w.dxEven[1] * dxSum[1];
+            return {even, odd};
+        };
+
+        for (size_t i = 0; i + 3 < in.size(); ++i)
+        {
+            auto dst = [&](const size_t r) -> SampleAndDerivative& { return out[i * 4 + r]; };
+            const double* x  = &in[i];
+            const double* dx = &din[i];
+            const array<double, 2> xSum   { x[0] + x[3],   x[1] + x[2]   };
+            const array<double, 2> xDiff  { x[0] - x[3],   x[1] - x[2]   };
+            const array<double, 2> dxSum  { dx[0] + dx[3], dx[1] + dx[2] };
+            const array<double, 2> dxDiff { dx[0] - dx[3], dx[1] - dx[2] };
+
+            const auto [sEven, sOdd] = Apply(Quarter.sample,     xSum, xDiff, dxSum, dxDiff);
+            const auto [dEven, dOdd] = Apply(Quarter.derivative, xSum, xDiff, dxSum, dxDiff);
+            dst(0).sample     = sEven + sOdd;
+            dst(2).sample     = sEven - sOdd;
+            dst(0).derivative = (dEven + dOdd) * SampleRate;
+            dst(2).derivative = (dOdd - dEven) * SampleRate;
+
+            dst(1).sample     = Apply(Half.sample,     xSum, xDiff, dxSum, dxDiff).first;
+            dst(1).derivative = Apply(Half.derivative, xSum, xDiff, dxSum, dxDiff).second * SampleRate;
+
+            dst(3).sample     = x[2];
+            dst(3).derivative = dx[2] * SampleRate;
+        }
+    }
+
+    void AddUpsampling (MicroBenchmarkSuite& suite)
+    {
+        constexpr size_t Inputs = KernelSamples / 4;
+
+        auto in  = make_shared<vector<double>>(SyntheticGuitar(Inputs + 3, 48'000.));
+        auto din = make_shared<vector<double>>(Inputs + 3);
+        for (size_t i = 3; i + 3 < in->size(); ++i)
+            (*din)[i] = ((*in)[i+3] - (*in)[i-3] - 9. * ((*in)[i+2] - (*in)[i-2]) + 45. * ((*in)[i+1] - (*in)[i-1])) / 60.;
+        auto dinPerSecond = make_shared<vector<double>>(*din);
+        for (double& d : *dinPerSecond) d *= 48'000.;
+
+        auto reference = make_shared<vector<SampleAndDerivative>>(4 * Inputs);
+        auto folded    = make_shared<vector<SampleAndDerivative>>(4 * Inputs);
+
+        // The engine's weights are derived from Hermite7 instead of written out, they must give the same signal
+        // (up to rounding, relative to the peak: the derivatives are differences of terms ~ 1 / h)
+        UpsampleBasicFIR(*in, *dinPerSecond, *reference);
+        UpsampleFoldedHermite(*in, *din, *folded);
+        double peak = 0.0, peakDerivative = 0.0, error = 0.0, errorDerivative = 0.0;
+        for (size_t n = 0; n < 4 * Inputs; ++n)
+        {
+            const auto& [s, d] = (*reference)[n];
+            peak            = max(peak, abs(s));
+            peakDerivative  = max(peakDerivative, abs(d));
+            error           = max(error, abs((*folded)[n].sample - s));
+            errorDerivative = max(errorDerivative, abs((*folded)[n].derivative - d));
+        }
+        if (error > 1e-13 * peak || errorDerivative > 1e-13 * peakDerivative)
+            throw runtime_error(format("Folded Hermite7 upsampling differs from Basic_FIR by {:.3g} (derivative: {:.3g})", error / peak, errorDerivative / peakDerivative));
+
+        suite.Add("Basic_FIR upsampling (AoS), 48 -> 192 kHz", Inputs, [=]
+        {
+            UpsampleBasicFIR(*in, *dinPerSecond, *reference);
+            DoNotOptimize(reference->back());
+        });
+        suite.Add("Hermite7 upsampling, folded (AoS), 48 -> 192 kHz", Inputs, [=]
+        {
+            UpsampleFoldedHermite(*in, *din, *folded);
+            DoNotOptimize(folded->back());
+        });
+    }
+
+    // Clipping stage solve at 192 kHz, inputs spread over the I-V table like in ClipperSolveBenchmark
+    void AddClipperSolve (MicroBenchmarkSuite& suite)
+    {
+        constexpr double h = 1. / 192'000.;
+        constexpr double Gain = 0.7;
+        const double A = DiodeClipperTableCache::CalcA(h, Gain);
+
+        auto solver = make_shared<DiodeClipperSolver>();
+        solver->SetA(A);
+        auto tables = make_shared<DiodeClipperTableCache>();
+        tables->Setup(h);
+        tables->SetA(A);
+
+        auto in = make_shared<vector<double>>(KernelSamples);
+        mt19937_64 rng{42};
+        uniform_real_distribution<double> dist{-solver->GetMaxC(), solver->GetMaxC()};
+        for (double& c : *in) c = dist(rng);
+
+        suite.Add("DiodeClipperSolver (exact)", KernelSamples, [=]
+        {
+            for (const double c : *in)
+                DoNotOptimize((*solver)(c));
+        });
+        suite.Add("DiodeClipperTableCache", KernelSamples, [=]
+        {
+            for (const double c : *in)
+                DoNotOptimize((*tables)(c));
+        });
+    }
+
+    void AddIIRs (MicroBenchmarkSuite& suite)
+    {
+        auto in  = make_shared<vector<double>>(SyntheticGuitar(KernelSamples, 192'000.));
+        auto out = make_shared<vector<double>>(KernelSamples);
+
+        // The Rg-Cg high-pass of the clipping stage at 192 kHz (the engine's defaults)
+        suite.Add("IIR_HighPass", KernelSamples, [=, hp = IIR_HighPass<>{-0.976696930369159, 0.988348465184579}]() mutable
+        {
+            for (size_t i = 0; i < KernelSamples; ++i)
+                (*out)[i] = hp((*in)[i]);
+            DoNotOptimize(out->back());
+        });
+        suite.Add("IIR_3_2_Executor (tone circuit)", KernelSamples, [=, tone = IIR_3_2_Executor<>{Tone_IIR_CoefficientTable(0.5)}]() mutable
+        {
+            for (size_t i = 0; i < KernelSamples; ++i)
+                (*out)[i] = tone((*in)[i]);
+            DoNotOptimize(out->back());
+        });
+        suite.Add("IIR_3_2_Executor<Lanes<2>> (tone circuit, stereo)", KernelSamples,
+                  [=, tone = IIR_3_2_Executor<Lanes<2>>{Tone_IIR_CoefficientTable(0.5)}]() mutable
+        {
+            for (size_t i = 0; i < KernelSamples; ++i)
+                (*out)[i] = tone(Lanes<2>{(*in)[i]})[0];
+            DoNotOptimize(out->back());
+        });
+    }
+
+    // The whole chain at the host sample rate, in the usual host block size
+    template<size_t Channels>
+    void AddEngine (MicroBenchmarkSuite& suite, const double sampleRate, const bool exactClipping)
+    {
+        constexpr size_t BlockSize = 256;
+        const size_t length = static_cast<size_t>(sampleRate / 10.) / BlockSize * BlockSize; // ~100 ms
+
+        auto in  = make_shared<vector<double>>(SyntheticGuitar(length, sampleRate));
+        auto out = make_shared<array<vector<double>, Channels>>();
+        for (auto& o : *out) o.resize(length);
+
+        auto engine = make_shared<TS808Engine<Channels>>();
+        engine->Setup(sampleRate);
+        engine->SetGain(0.7);
+        engine->SetExactClipping(exactClipping);
+
+        suite.Add(format("TS808Engine<{}>, {} Hz, {} clipping", Channels, sampleRate, exactClipping ? "exact" : "table"), length, [=]
+        {
+            for (size_t pos = 0; pos < length; pos += BlockSize)
+            {
+                array<const double*, Channels> inPtrs;
+                array<double*, Channels> outPtrs;
+                for (size_t c = 0; c < Channels; ++c)
+                {
+                    inPtrs[c]  = in->data() + pos;
+                    outPtrs[c] = (*out)[c].data() + pos;
+                }
+                engine->template ProcessFixed<BlockSize>(inPtrs.data(), outPtrs.data());
+            }
+            DoNotOptimize((*out)[0].back());
+        });
+    }
+
+} // namespace
+
+void RegisterTS808Kernels (MicroBenchmarkSuite& suite)
+{
+    AddPolyBase(suite);
+    AddUpsampling(suite);
+    AddClipperSolve(suite);
+    AddIIRs(suite);
+    for (const double sampleRate : {48'000., 96'000., 192'000.})
+        AddEngine<1>(suite, sampleRate, false);
+    AddEngine<1>(suite, 48'000., true);
+    AddEngine<2>(suite, 48'000., false);
+}
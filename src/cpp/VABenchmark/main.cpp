@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2025 Ték Róbert Máté <eppenpontaz@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Kernels.hpp"
+#include "MicroBenchmark.hpp"
+
+#include <charconv>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+
+using namespace std;
+using namespace TRM;
+
+// Microbenchmarks of every DSP kernel and of the whole TS808 chain, on synthetic inputs.
+//
+//   va_bench [--filter TEXT] [--repetitions N] [--warmup N] [--no-counters] [--json FILE] [--tag TEXT]
+//
+// Prints median, p99 and min wall time per run and the median ns / sample, plus cycles, IPC,
+// cache and branch misses per sample where the hardware counters are available (Linux).
+// --json also writes the results machine-readably, --tag is stored with them (e.g. the commit hash),
+// so that runs of different commits can be compared.
+
+struct Arguments
+{
+    MicroBenchmarkSettings settings;
+    optional<string> jsonPath;
+    string tag;
+};
+
+void PrintUsage ()
+{
+    cout << "Usage: va_bench [--filter TEXT] [--repetitions N] [--warmup N] [--no-counters] [--json FILE] [--tag TEXT]\n"
+            "  --filter        only run the benchmarks whose name contains TEXT\n"
+            "  --repetitions   timed runs per benchmark (default: 101)\n"
+            "  --warmup        untimed runs before them (default: 5)\n"
+            "  --no-counters   do not read the hardware performance counters\n"
+            "  --json          write the results to FILE as JSON\n"
+            "  --tag           label stored in the JSON, e.g. the commit hash\n";
+}
+
+optional<Arguments> ParseArguments (const int argc, const char* const* argv)
+{
+    Arguments args;
+
+    auto ParseNumber = [](const string_view arg, size_t& value) -> bool
+    {
+        const auto [ptr, ec] = from_chars(arg.data(), arg.data() + arg.size(), value);
+        return ec == errc{} && ptr == arg.data() + arg.size();
+    };
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const string_view arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+
+        bool ok = true;
+        if      (arg == "--filter"      && hasValue) args.settings.filter = argv[++i];
+        else if (arg == "--repetitions" && hasValue) ok = ParseNumber(argv[++i], args.settings.repetitions) && args.settings.repetitions > 0;
+        else if (arg == "--warmup"      && hasValue) ok = ParseNumber(argv[++i], args.settings.warmUpRuns);
+        else if (arg == "--no-counters")             args.settings.hardwareCounters = false;
+        else if (arg == "--json"        && hasValue) args.jsonPath = argv[++i];
+        else if (arg == "--tag"         && hasValue) args.tag = argv[++i];
+        else                                         ok = false;
+
+        if (!ok)
+        {
+            cout << format(" ! Invalid argument: {} !\n", arg);
+            return nullopt;
+        }
+    }
+    return args;
+}
+
+int main (const int argc, const char* const* argv)
+{
+    const auto args = ParseArguments(argc, argv);
+    if (!args)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    MicroBenchmarkSuite suite{args->settings};
+    try
+    {
+        RegisterNumMethodsKernels(suite);
+        RegisterTS808Kernels(suite);
+        suite.Run(cout);
+    }
+    catch (const exception& e)
+    {
+        // A kernel failed to check its own output
+        cout << format(" ! {} !\n", e.what());
+        return 1;
+    }
+
+    if (args->jsonPath)
+    {
+        ofstream json{*args->jsonPath};
+        suite.WriteJson(json, "va_bench", args->tag);
+        if (!json)
+        {
+            cout << format(" ! Failed to write {} !\n", *args->jsonPath);
+            return 1;
+        }
+    }
+}
@@ -16,25 +16,30 @@
  */
 
 #include "AudioFilePrompt.hpp"
-#include "CircleBuffer.hpp"
+#include "ChunkedRender.hpp"
 #include "FiniteDifferenceMethod.hpp"
 #include "Utility.hpp"
+#include "WavStream.hpp"
 
 #include <algorithm>
-#include <iomanip>
-#include <iterator>
-#include <numeric>
-#include <ranges>
-#include <utility>
+#include <array>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
 
 using namespace std;
 using namespace TRM;
 
-int main ()
+int main (const int argc, const char* const* argv)
 {
-    const auto inputFile192 = Prompt<ExistingAudioFile>("Enter input guitar DI file (192 kHz, > 10 samples, stereo)",
-                                                        AllOf | SampleRate(192'000) | NonEmpty | Stereo);
-    inputFile192.printSummary();
+    // --verify renders a chunked run serially too and reports the error at the seams
+    const bool verify = AnswerPromptsAndTakeVerify(argc, argv);
+
+    const auto inputFile192 = Prompt<ExistingWavFile>("Enter input guitar DI file (192 kHz, > 10 samples, stereo)",
+                                                      AllOf | SampleRate(192'000) | NonEmpty | Stereo);
+    inputFile192.PrintSummary();
 
     constexpr std::size_t LeftCh = 0u;
 
@@ -42,36 +47,62 @@ int main ()
 
     auto ToCorrectVoltage = [](double d){ return (d * FullScaleSampleVoltage); };
 
-    auto in96 = inputFile192.samples[LeftCh] | views::stride(2) | views::transform(ToCorrectVoltage);
-
     cout << " ! Assuming 0 dBFS = " << FullScaleSampleVoltage << " V !\n";
     cout << " ! Assuming Left channel is raw guitar DI !\n";
 
-    // -----------------
+    const ChunkedRenderSettings chunking = PromptChunkedRenderSettings(96'000.);
 
-    FiniteDiff<1./96000.> diff;
-
-    CircleBuffer<double, 7> in;
-    auto LoadIn = CreateBufferLoader(in, in96);
-    LoadIn(3);
+    auto outputFileName = Prompt<string>("Enter output file name: ", [](auto){ return true; });
 
-    vector<double> out_96;
-    out_96.reserve(inputFile192.samples[LeftCh].size() / 2);
+    // -----------------
 
-    for ([[maybe_unused]] auto d : in96)
+    // Every 2nd sample of the left channel, zeros after the end
+    WavReader reader{inputFile192.path};
+    SlidingWindow<double> window;
+    auto NextIn96 = [&]
     {
-        LoadIn(1);
-        out_96.push_back(diff.FirstDerivative(in));
-    }
+        const auto frame = reader.NextFrame(2);
+        return frame.empty() ? 0.0 : ToCorrectVoltage(frame[LeftCh]);
+    };
+    const auto len96 = (inputFile192.Format().frames + 1) / 2;
 
-    for(auto& d : out_96) d = d * 0.00033; // Scale by this magic number to avoid clipping
+    // The derivative lags the input by Latency samples: output k is ready once input k + Latency is pushed.
+    // A processor starts with zeros before its first input, a pre-roll of Latency samples makes it exact.
+    using Diff = FiniteDiffBlock<1./96000., 7, 1>;
+    constexpr std::size_t BlockSz = 1024;
 
-    AudioFile<double> outputFile;
-    outputFile.setSampleRate(96'000);
-    outputFile.setBitDepth(24);
-    outputFile.setAudioBuffer({move(out_96)});
-    auto outputFileName = Prompt<string>("Enter output file name: ", [](auto){ return true; });
-    if (!outputFile.save(outputFileName))
+    auto MakeProcessor = [&](WindowBuffers<1>& dst, const std::size_t& dstBegin)
+    {
+        return [&, diff = std::make_unique<Diff>(), next = std::optional<std::size_t>{}](const std::size_t begin, const std::size_t end,
+                                                                                      const bool warmUp) mutable
+        {
+            if (!next) next = begin;
+            std::array<double, BlockSz> in, din;
+            while (*next < end + Diff::Latency)
+            {
+                const std::size_t n = std::min<std::size_t>(BlockSz, end + Diff::Latency - *next);
+                for (std::size_t i = 0; i < n; ++i)
+                    in[i] = window[*next + i];
+                diff->Process(std::span{in}.first(n), {din.data()});
+
+                // din[i] is the derivative at sample *next + i - Latency
+                for (std::size_t i = 0; i < n; ++i)
+                    if (!warmUp && *next + i >= begin + Diff::Latency)
+                        dst[0][*next + i - Diff::Latency - dstBegin] = din[i] * 0.00033; // Scale by this magic number to avoid clipping
+                *next += n;
+            }
+        };
+    };
+
+    WavWriter outputFile{outputFileName, WavFormat{ .sampleRate = 96'000, .channels = 1, .bitDepth = 24 }};
+    const auto result = RenderInWindows(len96, chunking, verify,
+        [&](const std::size_t begin, const std::size_t end){ window.Slide(begin, end + Diff::Latency, NextIn96); },
+        MakeProcessor,
+        [&](const auto& rendered){ outputFile.Write(rendered[0]); });
+
+    result.Print("differentiation", 96'000.);
+
+    if (!outputFile.Close())
     {
         cout << " ! Failed to write output file !\n";
     }